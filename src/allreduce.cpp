@@ -0,0 +1,454 @@
+#include "allreduce.h"
+#include <Eigen/Core>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <new>
+#include <thread>
+
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// ====== SETTINGS ======
+int allreduce_timeout_ms = 60000;
+
+typedef std::chrono::steady_clock Clock;
+
+static Clock::time_point deadline_from_now()
+{
+    return Clock::now() + std::chrono::milliseconds(allreduce_timeout_ms);
+}
+
+static size_t bucket_floats(const GradBucket &bucket)
+{
+    size_t n = 0;
+    for (const GradSpan &s : bucket) n += s.size;
+    return n;
+}
+
+static void pack(const GradBucket &bucket, float *dst)
+{
+    for (const GradSpan &s : bucket) {
+        std::memcpy(dst, s.data, s.size * sizeof(float));
+        dst += s.size;
+    }
+}
+
+static void unpack(const float *src, const GradBucket &bucket)
+{
+    for (const GradSpan &s : bucket) {
+        std::memcpy(s.data, src, s.size * sizeof(float));
+        src += s.size;
+    }
+}
+
+
+// ------------------------------------------------------------
+// Shared memory: every rank copies its bucket into its own slot, each rank sums one
+// 1/world slice of all slots (reduce-scatter), then everyone copies the summed result
+// out (all-gather). Two barriers per all-reduce, no locks, no copies through the kernel.
+// ------------------------------------------------------------
+static_assert(std::atomic<uint32_t>::is_always_lock_free, "shared-memory barrier needs address-free atomics");
+
+struct alignas(64) ShmHeader
+{
+    std::atomic<uint32_t> magic;      // set by rank 0 once the segment is initialised
+    std::atomic<uint32_t> joined;     // ranks mapped so far
+    std::atomic<uint32_t> arrived;    // barrier count
+    std::atomic<uint32_t> generation; // barrier phase
+    std::atomic<uint32_t> failed;     // a rank gave up: everyone stops waiting
+};
+
+static const uint32_t kShmMagic = 0x56414552; // "VAER"
+
+class ShmTransport : public Transport
+{
+public:
+    ShmTransport(std::string name, int rank, int world, size_t maxFloats)
+        : name(std::move(name)), rank_(rank), world_(world), capacity(maxFloats) {}
+    ~ShmTransport() override
+    {
+        if (base) munmap(base, bytes);
+    }
+
+    bool open();
+    int rank() const override { return rank_; }
+    int size() const override { return world_; }
+    bool allreduce(const GradBucket &bucket) override;
+
+private:
+    bool barrier();
+    float *slot(int r) const { return reinterpret_cast<float *>(base + sizeof(ShmHeader)) + size_t(r) * capacity; }
+    float *result() const { return slot(world_); }
+
+    std::string name;
+    int rank_, world_;
+    size_t capacity; // floats per slot
+    size_t bytes = 0;
+    char *base = nullptr;
+    ShmHeader *hdr = nullptr;
+};
+
+bool ShmTransport::open()
+{
+    bytes = sizeof(ShmHeader) + (size_t(world_) + 1) * capacity * sizeof(float);
+    const std::string path = "/" + name;
+    const auto deadline = deadline_from_now();
+    int fd = -1;
+    if (rank_ == 0) {
+        shm_unlink(path.c_str()); // left over from a crashed run with the same name
+        fd = shm_open(path.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+        if (fd < 0 || ftruncate(fd, off_t(bytes)) != 0) {
+            std::cerr << "ERROR: cannot create shared memory " << path << ": " << std::strerror(errno) << "\n";
+            if (fd >= 0) close(fd);
+            return false;
+        }
+    } else {
+        struct stat st;
+        while ((fd = shm_open(path.c_str(), O_RDWR, 0600)) < 0 || fstat(fd, &st) != 0 || size_t(st.st_size) != bytes) {
+            if (fd >= 0) close(fd);
+            if (Clock::now() > deadline) {
+                std::cerr << "ERROR: rank " << rank_ << " timed out waiting for shared memory " << path << "\n";
+                return false;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+    void *p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) {
+        std::cerr << "ERROR: cannot map shared memory " << path << ": " << std::strerror(errno) << "\n";
+        return false;
+    }
+    base = static_cast<char *>(p);
+    if (rank_ == 0) {
+        hdr = new (base) ShmHeader{};
+        hdr->magic.store(kShmMagic, std::memory_order_release);
+    } else {
+        hdr = reinterpret_cast<ShmHeader *>(base);
+        while (hdr->magic.load(std::memory_order_acquire) != kShmMagic) {
+            if (Clock::now() > deadline) {
+                std::cerr << "ERROR: rank " << rank_ << " timed out waiting for rank 0 to initialise " << path << "\n";
+                return false;
+            }
+            std::this_thread::yield();
+        }
+    }
+    hdr->joined.fetch_add(1);
+    if (rank_ == 0) {
+        while (hdr->joined.load() < uint32_t(world_)) {
+            if (Clock::now() > deadline) {
+                std::cerr << "ERROR: only " << hdr->joined.load() << " of " << world_ << " ranks joined " << path << "\n";
+                return false;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        shm_unlink(path.c_str()); // everyone has it mapped: nothing is left behind, even after a crash
+    }
+    return true;
+}
+
+/**
+ * @brief Sense-reversing barrier on two counters in the segment. Spins briefly, then yields,
+ * @brief then sleeps (ranks may outnumber cores).
+ */
+bool ShmTransport::barrier()
+{
+    const uint32_t gen = hdr->generation.load(std::memory_order_acquire);
+    if (hdr->arrived.fetch_add(1, std::memory_order_acq_rel) + 1 == uint32_t(world_)) {
+        hdr->arrived.store(0, std::memory_order_relaxed);
+        hdr->generation.fetch_add(1, std::memory_order_release);
+        return true;
+    }
+    const auto deadline = deadline_from_now();
+    for (unsigned spin = 0; hdr->generation.load(std::memory_order_acquire) == gen; ++spin) {
+        if (hdr->failed.load(std::memory_order_relaxed)) return false;
+        if (spin > 4096) std::this_thread::sleep_for(std::chrono::microseconds(20)); // oversubscribed: give the core away
+        else if (spin > 64) std::this_thread::yield();
+        if ((spin & 1023) == 0 && Clock::now() > deadline) {
+            std::cerr << "ERROR: rank " << rank_ << " timed out in a shared-memory barrier\n";
+            hdr->failed.store(1);
+            return false;
+        }
+    }
+    return true;
+}
+
+bool ShmTransport::allreduce(const GradBucket &bucket)
+{
+    if (world_ == 1) return true;
+    const size_t n = bucket_floats(bucket);
+    if (n > capacity) {
+        std::cerr << "ERROR: bucket of " << n << " floats exceeds the shared-memory slot (" << capacity << ")\n";
+        return false;
+    }
+    pack(bucket, slot(rank_));
+    if (!barrier()) return false;
+
+    const size_t lo = size_t(rank_) * n / size_t(world_);
+    const size_t hi = size_t(rank_ + 1) * n / size_t(world_);
+    Eigen::Map<Eigen::VectorXf> sum(result() + lo, Eigen::Index(hi - lo));
+    sum = Eigen::Map<const Eigen::VectorXf>(slot(0) + lo, Eigen::Index(hi - lo));
+    for (int r = 1; r < world_; ++r) sum += Eigen::Map<const Eigen::VectorXf>(slot(r) + lo, Eigen::Index(hi - lo)); // fixed rank order
+    if (!barrier()) return false;
+
+    unpack(result(), bucket);
+    return true;
+}
+
+
+// ------------------------------------------------------------
+// TCP ring: rank r sends to r+1 and receives from r-1. Reduce-scatter then all-gather,
+// 2 (world - 1) steps of n / world floats each, so every link carries the same bytes
+// whatever the number of ranks. Each step sends and receives at once (poll), so neither
+// side can fill its socket buffer and block the other.
+// ------------------------------------------------------------
+struct Address
+{
+    std::string host;
+    int port;
+};
+
+class TcpTransport : public Transport
+{
+public:
+    TcpTransport(std::vector<Address> peers, int rank, int world) : peers(std::move(peers)), rank_(rank), world_(world) {}
+    ~TcpTransport() override
+    {
+        for (int fd : {listenFd, nextFd, prevFd})
+            if (fd >= 0) close(fd);
+    }
+
+    bool open();
+    int rank() const override { return rank_; }
+    int size() const override { return world_; }
+    bool allreduce(const GradBucket &bucket) override;
+
+private:
+    bool exchange(const float *out, size_t outFloats, float *in, size_t inFloats);
+
+    std::vector<Address> peers;
+    int rank_, world_;
+    int listenFd = -1, nextFd = -1, prevFd = -1;
+    std::vector<float> buf, incoming;
+};
+
+static addrinfo *resolve(const Address &a, bool passive)
+{
+    addrinfo hints{};
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = passive ? AI_PASSIVE : 0;
+    addrinfo *res = nullptr;
+    if (getaddrinfo(a.host.c_str(), std::to_string(a.port).c_str(), &hints, &res) != 0) return nullptr;
+    return res;
+}
+
+static bool send_all(int fd, const void *data, size_t len)
+{
+    const char *p = static_cast<const char *>(data);
+    while (len > 0) {
+        const ssize_t n = ::send(fd, p, len, 0);
+        if (n <= 0) return false;
+        p += n;
+        len -= size_t(n);
+    }
+    return true;
+}
+
+static void tune_socket(int fd)
+{
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one)); // buckets are latency-bound at the tail
+#ifdef SO_NOSIGPIPE
+    setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+}
+
+bool TcpTransport::open()
+{
+    if (world_ == 1) return true;
+    const auto deadline = deadline_from_now();
+
+    addrinfo *self = resolve(peers[size_t(rank_)], true);
+    if (!self) {
+        std::cerr << "ERROR: cannot resolve " << peers[size_t(rank_)].host << "\n";
+        return false;
+    }
+    listenFd = socket(self->ai_family, self->ai_socktype, self->ai_protocol);
+    int one = 1;
+    setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    const bool listening = listenFd >= 0 && bind(listenFd, self->ai_addr, self->ai_addrlen) == 0 && listen(listenFd, 4) == 0;
+    freeaddrinfo(self);
+    if (!listening) {
+        std::cerr << "ERROR: rank " << rank_ << " cannot listen on port " << peers[size_t(rank_)].port << ": " << std::strerror(errno) << "\n";
+        return false;
+    }
+
+    // Connect forward first: the peer's listen backlog completes it before that peer accepts.
+    const Address &next = peers[size_t((rank_ + 1) % world_)];
+    while (nextFd < 0) {
+        addrinfo *res = resolve(next, false);
+        if (res) {
+            nextFd = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+            if (nextFd >= 0 && connect(nextFd, res->ai_addr, res->ai_addrlen) != 0) {
+                close(nextFd);
+                nextFd = -1;
+            }
+            freeaddrinfo(res);
+        }
+        if (nextFd >= 0) break;
+        if (Clock::now() > deadline) {
+            std::cerr << "ERROR: rank " << rank_ << " cannot connect to " << next.host << ":" << next.port << "\n";
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    const uint32_t me = uint32_t(rank_);
+    if (!send_all(nextFd, &me, sizeof(me))) return false;
+
+    pollfd pfd{listenFd, POLLIN, 0};
+    const int waitMs = int(std::max<long long>(0, std::chrono::duration_cast<std::chrono::milliseconds>(deadline - Clock::now()).count()));
+    if (poll(&pfd, 1, waitMs) <= 0 || (prevFd = accept(listenFd, nullptr, nullptr)) < 0) {
+        std::cerr << "ERROR: rank " << rank_ << " timed out waiting for rank " << (rank_ + world_ - 1) % world_ << "\n";
+        return false;
+    }
+    uint32_t who = 0;
+    if (recv(prevFd, &who, sizeof(who), MSG_WAITALL) != ssize_t(sizeof(who)) || who != uint32_t((rank_ + world_ - 1) % world_)) {
+        std::cerr << "ERROR: rank " << rank_ << " expected rank " << (rank_ + world_ - 1) % world_ << " on its incoming link\n";
+        return false;
+    }
+    close(listenFd);
+    listenFd = -1;
+
+    for (int fd : {nextFd, prevFd}) {
+        tune_socket(fd);
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    }
+    return true;
+}
+
+/**
+ * @brief Send outFloats to the next rank while receiving inFloats from the previous one.
+ */
+bool TcpTransport::exchange(const float *out, size_t outFloats, float *in, size_t inFloats)
+{
+#ifdef MSG_NOSIGNAL
+    const int sendFlags = MSG_NOSIGNAL;
+#else
+    const int sendFlags = 0;
+#endif
+    const char *src = reinterpret_cast<const char *>(out);
+    char *dst = reinterpret_cast<char *>(in);
+    const size_t outBytes = outFloats * sizeof(float), inBytes = inFloats * sizeof(float);
+    size_t sent = 0, got = 0;
+    while (sent < outBytes || got < inBytes) {
+        pollfd fds[2];
+        int nfds = 0, sendIdx = -1, recvIdx = -1;
+        if (sent < outBytes) { sendIdx = nfds; fds[nfds++] = {nextFd, POLLOUT, 0}; }
+        if (got < inBytes) { recvIdx = nfds; fds[nfds++] = {prevFd, POLLIN, 0}; }
+        const int ready = poll(fds, nfds_t(nfds), allreduce_timeout_ms);
+        if (ready < 0 && errno == EINTR) continue;
+        if (ready <= 0) {
+            std::cerr << "ERROR: rank " << rank_ << (ready == 0 ? " timed out in a ring step\n" : " poll failed\n");
+            return false;
+        }
+        if (sendIdx >= 0 && (fds[sendIdx].revents & (POLLOUT | POLLERR | POLLHUP))) {
+            const ssize_t n = ::send(nextFd, src + sent, outBytes - sent, sendFlags);
+            if (n > 0) sent += size_t(n);
+            else if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                std::cerr << "ERROR: rank " << rank_ << " lost the link to the next rank: " << std::strerror(errno) << "\n";
+                return false;
+            }
+        }
+        if (recvIdx >= 0 && (fds[recvIdx].revents & (POLLIN | POLLERR | POLLHUP))) {
+            const ssize_t n = ::recv(prevFd, dst + got, inBytes - got, 0);
+            if (n > 0) got += size_t(n);
+            else if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+                std::cerr << "ERROR: rank " << rank_ << " lost the link to the previous rank\n";
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool TcpTransport::allreduce(const GradBucket &bucket)
+{
+    if (world_ == 1) return true;
+    const size_t n = bucket_floats(bucket);
+    buf.resize(n);
+    pack(bucket, buf.data());
+
+    const int W = world_, r = rank_;
+    auto lo = [&](int k) { return size_t(k) * n / size_t(W); };
+    auto len = [&](int k) { return lo(k + 1) - lo(k); };
+    incoming.resize(len(W - 1) + 1);
+
+    for (int s = 0; s < W - 1; ++s) { // reduce-scatter: afterwards rank r owns the full sum of chunk r + 1
+        const int out = (r - s + W) % W, in = (r - s - 1 + 2 * W) % W;
+        if (!exchange(buf.data() + lo(out), len(out), incoming.data(), len(in))) return false;
+        Eigen::Map<Eigen::VectorXf>(buf.data() + lo(in), Eigen::Index(len(in))) +=
+            Eigen::Map<const Eigen::VectorXf>(incoming.data(), Eigen::Index(len(in)));
+    }
+    for (int s = 0; s < W - 1; ++s) { // all-gather: pass the finished chunks around the ring
+        const int out = (r + 1 - s + W) % W, in = (r - s + W) % W;
+        if (!exchange(buf.data() + lo(out), len(out), buf.data() + lo(in), len(in))) return false;
+    }
+    unpack(buf.data(), bucket);
+    return true;
+}
+
+
+// ------------------------------------------------------------
+// Public: transport from a spec string
+// ------------------------------------------------------------
+std::unique_ptr<Transport> open_transport(const std::string &spec, int rank, int world, size_t maxFloats)
+{
+    if (world < 1 || rank < 0 || rank >= world) {
+        std::cerr << "ERROR: rank " << rank << " is outside a job of " << world << "\n";
+        return nullptr;
+    }
+    if (spec.rfind("shm:", 0) == 0) {
+        auto t = std::make_unique<ShmTransport>(spec.substr(4), rank, world, maxFloats);
+        if (!t->open()) return nullptr;
+        return t;
+    }
+    if (spec.rfind("tcp:", 0) == 0) {
+        std::vector<Address> peers;
+        size_t pos = 4;
+        while (pos <= spec.size()) {
+            const size_t end = std::min(spec.find(',', pos), spec.size());
+            const std::string item = spec.substr(pos, end - pos);
+            const size_t colon = item.rfind(':');
+            if (colon == std::string::npos) {
+                std::cerr << "ERROR: expected HOST:PORT in " << spec << "\n";
+                return nullptr;
+            }
+            peers.push_back({item.substr(0, colon), std::atoi(item.c_str() + colon + 1)});
+            pos = end + 1;
+        }
+        if (peers.size() == 1) // one address: consecutive ports on that host
+            for (int r = 1; r < world; ++r) peers.push_back({peers[0].host, peers[0].port + r});
+        if (int(peers.size()) != world) {
+            std::cerr << "ERROR: " << peers.size() << " addresses for " << world << " ranks\n";
+            return nullptr;
+        }
+        auto t = std::make_unique<TcpTransport>(std::move(peers), rank, world);
+        if (!t->open()) return nullptr;
+        return t;
+    }
+    std::cerr << "ERROR: unknown transport " << spec << " (expected shm:NAME or tcp:HOST:PORT[,...])\n";
+    return nullptr;
+}
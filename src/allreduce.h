@@ -0,0 +1,41 @@
+#ifndef ALLREDUCE_H
+#define ALLREDUCE_H
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+// ====== SETTINGS ======
+extern int allreduce_timeout_ms; // how long a rank waits on its peers (setup or one all-reduce) before giving up
+
+// A bucket is a list of float tensors reduced together as one message (e.g. one layer's W and b).
+struct GradSpan
+{
+    float *data;
+    size_t size;
+};
+typedef std::vector<GradSpan> GradBucket;
+
+/**
+ * @brief Sums buckets across the ranks of a job, in place: afterwards every rank holds the same
+ * @brief bits. Every rank must issue the same sequence of allreduce() calls with the same sizes.
+ * @brief Implementations: shared memory (ranks on one machine) and a TCP ring (any machines).
+ */
+class Transport
+{
+public:
+    virtual ~Transport() = default;
+    virtual int rank() const = 0;
+    virtual int size() const = 0;
+    virtual bool allreduce(const GradBucket &bucket) = 0; // false on a peer failure or timeout
+};
+
+// spec:
+//   shm:NAME                  POSIX shared memory segment /NAME, one machine; NAME unique per job
+//   tcp:HOST:PORT             rank r listens on HOST:(PORT + r)
+//   tcp:HOST:PORT,HOST:PORT.. rank r listens on the r-th address (one per rank)
+// maxFloats bounds the largest bucket (the shared-memory slots are sized from it).
+std::unique_ptr<Transport> open_transport(const std::string &spec, int rank, int world, size_t maxFloats);
+
+#endif // ALLREDUCE_H
@@ -0,0 +1,126 @@
+#include "anomaly.h"
+#include "profiler.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+// ====== SETTINGS ======
+int score_batch = 256;
+
+void reconstruction_scores(const Weights &weights, const MatrixXu8 &X, Eigen::VectorXf &scores, ThreadPool &pool)
+{
+    PROFILE_SCOPE("score");
+    scores.resize(X.rows());
+    pool.parallelForRows(long(X.rows()), score_batch, [&](long begin, long end) {
+        const auto x = X.middleRows(begin, end - begin).cast<float>().array() * (1.0f / 255.0f);
+        MatrixXfRow H = x.matrix() * weights.W1;
+        H.rowwise() += weights.b1;
+        H = H.array().tanh();
+        MatrixXfRow A2 = H * weights.W2;
+        A2.rowwise() += weights.b2;
+        A2 = A2.array().tanh();
+        MatrixXfRow Y = A2 * weights.W3;
+        Y.rowwise() += weights.b3;
+        // -[x log s(y) + (1-x) log(1-s(y))] = softplus(y) - x y, stable for any |y|
+        const auto y = Y.array();
+        scores.segment(begin, end - begin) = (y.max(0.0f) - x * y + (-y.abs()).exp().log1p()).rowwise().sum();
+    });
+}
+
+
+void WorstK::add(const Eigen::VectorXf &scores, size_t firstIndex)
+{
+    auto worse = [](const ScoredImage &a, const ScoredImage &b) { return a.score > b.score; }; // min-heap
+    for (Eigen::Index i = 0; i < scores.size(); ++i) {
+        if (heap.size() == k && !(scores(i) > heap.front().score)) continue;
+        heap.push_back({firstIndex + size_t(i), scores(i)});
+        std::push_heap(heap.begin(), heap.end(), worse);
+        if (heap.size() > k) {
+            std::pop_heap(heap.begin(), heap.end(), worse);
+            heap.pop_back();
+        }
+    }
+}
+
+std::vector<ScoredImage> WorstK::sorted() const
+{
+    std::vector<ScoredImage> out = heap;
+    std::sort(out.begin(), out.end(), [](const ScoredImage &a, const ScoredImage &b) {
+        return a.score > b.score || (a.score == b.score && a.index < b.index);
+    });
+    return out;
+}
+
+
+// ------------------------------------------------------------
+// Score file
+// ------------------------------------------------------------
+static const char kMagic[4] = {'V', 'A', 'E', 'S'};
+static const uint32_t kFormat = 1;
+
+static void write_header(std::ofstream &f, uint64_t count, uint32_t dim)
+{
+    const uint32_t reserved = 0;
+    f.write(kMagic, sizeof(kMagic));
+    f.write((const char *)&kFormat, sizeof(kFormat));
+    f.write((const char *)&count, sizeof(count));
+    f.write((const char *)&dim, sizeof(dim));
+    f.write((const char *)&reserved, sizeof(reserved));
+}
+
+bool ScoreWriter::open(const std::string &outPath, int d)
+{
+    path = outPath;
+    count = 0;
+    dim = uint32_t(d);
+    f = std::ofstream(path, std::ios::binary);
+    if (!f) {
+        std::cerr << "ERROR: cannot write score file: " << path << "\n";
+        return false;
+    }
+    write_header(f, 0, dim); // count patched in close()
+    return bool(f);
+}
+
+bool ScoreWriter::append(const Eigen::VectorXf &scores)
+{
+    f.write((const char *)scores.data(), std::streamsize(scores.size() * sizeof(float)));
+    count += uint64_t(scores.size());
+    return bool(f);
+}
+
+bool ScoreWriter::close()
+{
+    f.seekp(0);
+    write_header(f, count, dim);
+    f.close();
+    if (!f) {
+        std::cerr << "ERROR: short write on score file: " << path << "\n";
+        return false;
+    }
+    return true;
+}
+
+bool read_score_file(const std::string &path, std::vector<float> &scores, int *dim)
+{
+    std::ifstream f(path, std::ios::binary);
+    char magic[4];
+    uint32_t format = 0, d = 0, reserved = 0;
+    uint64_t count = 0;
+    f.read(magic, sizeof(magic));
+    f.read((char *)&format, sizeof(format));
+    f.read((char *)&count, sizeof(count));
+    f.read((char *)&d, sizeof(d));
+    f.read((char *)&reserved, sizeof(reserved));
+    if (!f || std::memcmp(magic, kMagic, sizeof(kMagic)) != 0 || format != kFormat) {
+        std::cerr << "ERROR: not a score file: " << path << "\n";
+        return false;
+    }
+    scores.resize(size_t(count));
+    if (!f.read((char *)scores.data(), std::streamsize(count * sizeof(float)))) {
+        std::cerr << "ERROR: truncated score file: " << path << "\n";
+        return false;
+    }
+    if (dim) *dim = int(d);
+    return true;
+}
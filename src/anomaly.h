@@ -0,0 +1,60 @@
+#ifndef ANOMALY_H
+#define ANOMALY_H
+
+#include "network.h"
+#include "thread_pool.h"
+#include <fstream>
+#include <string>
+#include <vector>
+
+// ====== SETTINGS ======
+extern int score_batch; // rows per inference block when scoring
+
+/**
+ * @brief Per-image reconstruction BCE, summed over the D pixels (nats per image).
+ * @brief Forward only, in score_batch-row blocks on the pool; the loss is taken straight from the
+ * @brief logits, softplus(y) - x y, in one pass per block, so the sigmoid output is never stored.
+ * @param scores REFERENCE : resized to X.rows().
+ */
+void reconstruction_scores(const Weights &weights, const MatrixXu8 &X, Eigen::VectorXf &scores, ThreadPool &pool = global_pool());
+
+struct ScoredImage
+{
+    size_t index; // position in the input stream
+    float score;
+};
+
+/**
+ * @brief The k highest scores seen so far (min-heap on score, so the weakest entry is evicted first).
+ */
+class WorstK
+{
+public:
+    explicit WorstK(size_t k) : k(k) {}
+    void add(const Eigen::VectorXf &scores, size_t firstIndex);
+    std::vector<ScoredImage> sorted() const; // worst first
+
+private:
+    size_t k;
+    std::vector<ScoredImage> heap;
+};
+
+// Score file: "VAES", u32 format version, u64 count, u32 dim, u32 reserved, then count
+// float32 scores in stream order (native endianness): 4 bytes per image.
+class ScoreWriter
+{
+public:
+    bool open(const std::string &path, int dim);
+    bool append(const Eigen::VectorXf &scores);
+    bool close(); // writes the final count into the header
+
+private:
+    std::ofstream f;
+    std::string path;
+    uint64_t count = 0;
+    uint32_t dim = 0;
+};
+
+bool read_score_file(const std::string &path, std::vector<float> &scores, int *dim = nullptr);
+
+#endif // ANOMALY_H
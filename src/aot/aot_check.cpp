@@ -0,0 +1,82 @@
+#include "aot_model.h" // generated: make aot CHECKPOINT=PATH
+#include "../shape.h"
+#include "../weight_store.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+// Usage: aot_check [--images N] [--tolerance T] [--train SPEC] [--test SPEC] [--raw WxHxC] [--cache DIR]
+// Checks the compiled model against forwardPass on the checkpoint it was generated from, one test
+// image at a time (outputs and loss within T), then times batch-1 inference with both.
+// Exit status 1 if any image is out of tolerance.
+
+template <typename F>
+static double median_us(int reps, F &&run)
+{
+    double best = 1e30;
+    for (int round = 0; round < 5; ++round) { // best median of 5 rounds
+        std::vector<double> us;
+        for (int rep = 0; rep < reps; ++rep) {
+            const auto t0 = std::chrono::steady_clock::now();
+            run(rep);
+            us.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count());
+        }
+        std::nth_element(us.begin(), us.begin() + long(us.size() / 2), us.end());
+        best = std::min(best, us[us.size() / 2]);
+    }
+    return best;
+}
+
+int main(int argc, char **argv)
+{
+    int images = 1000;
+    double tolerance = 1e-5;
+    for (int i = 1; i < argc; ++i) {
+        auto next = [&]() { return (i + 1 < argc) ? argv[++i] : (std::cerr << "missing value for " << argv[i] << "\n", std::exit(2), nullptr); };
+        if (parse_dataset_flag(argc, argv, i)) continue; // --train --test --raw --cache
+        if (!std::strcmp(argv[i], "--images")) images = std::max(1, std::atoi(next()));
+        else if (!std::strcmp(argv[i], "--tolerance")) tolerance = std::atof(next());
+        else {
+            std::cerr << "usage: " << argv[0] << " [--images N] [--tolerance T]" << dataset_flags_usage << "\n";
+            return 2;
+        }
+    }
+
+    load_datasets(false); // sets D; only test images are checked
+    Weights weights;
+    if (!load_checkpoint(aot_model::kCheckpoint, weights)) return 1;
+    if (weights.W1.rows() != aot_model::kInputs || weights.W1.cols() != aot_model::kHidden1 || weights.W2.cols() != aot_model::kHidden2 ||
+        D != aot_model::kInputs) {
+        std::cerr << "ERROR: " << aot_model::kCheckpoint << " or the dataset no longer matches the compiled model\n";
+        return 1;
+    }
+
+    MatrixXu8 X;
+    dataset(false).read(0, size_t(images), X);
+    std::vector<MatrixXu8> rows;
+    for (Eigen::Index r = 0; r < X.rows(); ++r) rows.push_back(X.row(r));
+
+    ForwardOutput forward;
+    float out[aot_model::kInputs];
+    double worstOut = 0.0, worstLoss = 0.0;
+    for (size_t r = 0; r < rows.size(); ++r) {
+        forwardPass(forward, weights, rows[r]);
+        const float loss = aot_model::reconstruct(rows[r].data(), out);
+        for (int d = 0; d < aot_model::kInputs; ++d) worstOut = std::max(worstOut, double(std::abs(out[d] - forward.sigmoid(0, d))));
+        worstLoss = std::max(worstLoss, std::abs(double(loss) - forward.loss));
+    }
+    const bool ok = worstOut <= tolerance && worstLoss <= tolerance;
+    std::cout << "compiled vs forwardPass over " << rows.size() << " test images: max |d output| = " << worstOut
+              << ", max |d loss| = " << worstLoss << (ok ? "  OK\n" : "  FAILED\n");
+
+    const int n = int(rows.size());
+    const double eigenUs = median_us(500, [&](int rep) { forwardPass(forward, weights, rows[size_t(rep % n)]); });
+    volatile float sink = 0.0f;
+    const double compiledUs = median_us(500, [&](int rep) { sink = aot_model::reconstruct(rows[size_t(rep % n)].data(), out); });
+    std::cout << "batch-1 latency: forwardPass " << eigenUs << " us, compiled " << compiledUs << " us (" << eigenUs / compiledUs << "x)\n";
+    return ok ? 0 : 1;
+}
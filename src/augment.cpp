@@ -0,0 +1,217 @@
+#include "augment.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+
+// ====== SETTINGS ======
+float augment_shift = 0.0f;
+float augment_rotate = 0.0f;
+float augment_scale = 0.0f;
+float augment_elastic = 0.0f;
+float augment_elastic_cell = 4.0f;
+float augment_noise = 0.0f;
+
+bool augment_enabled()
+{
+    return augment_shift > 0.0f || augment_rotate > 0.0f || augment_scale > 0.0f || augment_elastic > 0.0f || augment_noise > 0.0f;
+}
+
+bool set_augment(const std::string &spec)
+{
+    float shift = 0.0f, rotate = 0.0f, scale = 0.0f, elastic = 0.0f, cell = augment_elastic_cell, noise = 0.0f;
+    if (spec != "off") {
+        std::stringstream ss(spec);
+        for (std::string item; std::getline(ss, item, ',');) {
+            const size_t eq = item.find('=');
+            const std::string key = item.substr(0, eq);
+            float *target = key == "shift" ? &shift : key == "rotate" ? &rotate : key == "scale" ? &scale
+                          : key == "elastic" ? &elastic : key == "cell" ? &cell : key == "noise" ? &noise : nullptr;
+            char *end = nullptr;
+            const float value = eq == std::string::npos ? -1.0f : std::strtof(item.c_str() + eq + 1, &end);
+            if (!target || !(value >= 0.0f) || end == item.c_str() + eq + 1 || *end) {
+                std::cerr << "ERROR: bad augmentation '" << item << "' (shift=P,rotate=DEG,scale=F,elastic=P,cell=P,noise=S or off)\n";
+                return false;
+            }
+            *target = value;
+        }
+    }
+    if (scale >= 1.0f || cell < 1.0f) {
+        std::cerr << "ERROR: augmentation needs scale < 1 and cell >= 1\n";
+        return false;
+    }
+    augment_shift = shift;
+    augment_rotate = rotate;
+    augment_scale = scale;
+    augment_elastic = elastic;
+    augment_elastic_cell = cell;
+    augment_noise = noise;
+    return true;
+}
+
+// ------------------------------------------------------------
+// Random numbers: a hash of (key + counter) instead of a generator's state, so any pixel's
+// number is known without drawing the ones before it. lowbias32 (C. Wellons): full avalanche,
+// integer multiplies and shifts only, so a loop over a counter range vectorises.
+// ------------------------------------------------------------
+static inline uint32_t mix32(uint32_t x)
+{
+    x ^= x >> 16;
+    x *= 0x7feb352dU;
+    x ^= x >> 15;
+    x *= 0x846ca68bU;
+    x ^= x >> 16;
+    return x;
+}
+
+static inline float uniform_pm1(uint32_t h) // [-1, 1)
+{
+    return float(int32_t(h)) * (1.0f / 2147483648.0f);
+}
+
+namespace {
+
+// The same for every image of a shape: pixel coordinates about the centre, and for every column
+// (row) the elastic control point left of (above) it, with its smoothstep weight.
+struct PixelGrid
+{
+    Eigen::ArrayXf u, v;         // per pixel
+    Eigen::ArrayXi col, row;     // per column, per row
+    Eigen::ArrayXf wx, wy;
+    int cellsX = 0, cells = 0;
+
+    PixelGrid(const ImageShape &shape, float spacing)
+    {
+        const int W = shape.width, H = shape.height;
+        u.resize(W * H);
+        v.resize(W * H);
+        for (int y = 0, p = 0; y < H; ++y) {
+            for (int x = 0; x < W; ++x, ++p) {
+                u(p) = float(x) - 0.5f * float(W - 1);
+                v(p) = float(y) - 0.5f * float(H - 1);
+            }
+        }
+        auto controls = [&](int n, Eigen::ArrayXi &index, Eigen::ArrayXf &weight) {
+            index.resize(n);
+            weight.resize(n);
+            for (int i = 0; i < n; ++i) {
+                const float g = float(i) / spacing, t = g - std::floor(g);
+                index(i) = int(g);
+                weight(i) = t * t * (3.0f - 2.0f * t); // smoothstep: C1 across control points
+            }
+            return int(std::ceil(float(n - 1) / spacing)) + 2;
+        };
+        cellsX = controls(W, col, wx);
+        cells = cellsX * controls(H, row, wy);
+    }
+};
+
+// Per block of images: reused for every image of the block.
+struct Scratch
+{
+    Eigen::ArrayXf padded;         // source planes with a ring of zeros: (H + 2) x (W + 2) per channel
+    Eigen::ArrayXf sx, sy, fx, fy; // source position of every output pixel (padded coordinates), fractions
+    Eigen::ArrayXi base;           // padded index of the top-left tap
+    Eigen::ArrayXf ctrlX, ctrlY;   // elastic displacements at the control points
+    Eigen::ArrayXf lineX, lineY;   // and interpolated down to the current pixel row
+    Eigen::ArrayXf value;          // the image, HWC floats 0..255
+};
+
+} // namespace
+
+static void augment_image(uint8_t *pixels, const ImageShape &shape, const PixelGrid &grid, uint32_t key, Scratch &s)
+{
+    const int W = shape.width, H = shape.height, C = shape.channels, n = W * H;
+    const int Wp = W + 2, plane = Wp * (H + 2);
+    Eigen::Map<Eigen::Array<uint8_t, Eigen::Dynamic, 1>> image(pixels, Eigen::Index(n) * C);
+    const bool geometric = augment_shift > 0.0f || augment_rotate > 0.0f || augment_scale > 0.0f || augment_elastic > 0.0f;
+
+    if (!geometric) {
+        s.value = image.cast<float>();
+    } else {
+        const float tx = augment_shift * uniform_pm1(mix32(key + 0)), ty = augment_shift * uniform_pm1(mix32(key + 1));
+        const float angle = augment_rotate * (3.14159265f / 180.0f) * uniform_pm1(mix32(key + 2));
+        const float zoom = 1.0f + augment_scale * uniform_pm1(mix32(key + 3));
+        const float a = std::cos(angle) / zoom, b = std::sin(angle) / zoom; // output -> source: inverse rotation and zoom
+
+        s.sx = a * (grid.u - tx) + b * (grid.v - ty) + (0.5f * float(W - 1) + 1.0f); // +1: the zero ring
+        s.sy = a * (grid.v - ty) - b * (grid.u - tx) + (0.5f * float(H - 1) + 1.0f);
+        if (augment_elastic > 0.0f) {
+            s.ctrlX.resize(grid.cells);
+            s.ctrlY.resize(grid.cells);
+            for (int c = 0; c < grid.cells; ++c) {
+                s.ctrlX(c) = augment_elastic * uniform_pm1(mix32(key + 16 + 2 * uint32_t(c)));
+                s.ctrlY(c) = augment_elastic * uniform_pm1(mix32(key + 17 + 2 * uint32_t(c)));
+            }
+            const int cx = grid.cellsX;
+            s.lineX.resize(cx);
+            s.lineY.resize(cx);
+            for (int y = 0; y < H; ++y) { // separable: between control rows first, then along the row
+                const float *x0 = s.ctrlX.data() + grid.row(y) * cx, *y0 = s.ctrlY.data() + grid.row(y) * cx;
+                const float wy = grid.wy(y);
+                for (int g = 0; g < cx; ++g) {
+                    s.lineX(g) = x0[g] + wy * (x0[g + cx] - x0[g]);
+                    s.lineY(g) = y0[g] + wy * (y0[g + cx] - y0[g]);
+                }
+                float *sx = s.sx.data() + y * W, *sy = s.sy.data() + y * W;
+                for (int x = 0; x < W; ++x) {
+                    const int g = grid.col(x);
+                    sx[x] += s.lineX(g) + grid.wx(x) * (s.lineX(g + 1) - s.lineX(g));
+                    sy[x] += s.lineY(g) + grid.wx(x) * (s.lineY(g + 1) - s.lineY(g));
+                }
+            }
+        }
+        // Past the image the taps land on the zero ring; both coordinates stay >= 0, so the cast floors.
+        s.sx = s.sx.cwiseMax(0.0f).cwiseMin(float(W) + 0.999f);
+        s.sy = s.sy.cwiseMax(0.0f).cwiseMin(float(H) + 0.999f);
+        s.base = s.sy.cast<int>() * Wp + s.sx.cast<int>();
+        s.fx = s.sx - s.sx.cast<int>().cast<float>();
+        s.fy = s.sy - s.sy.cast<int>().cast<float>();
+
+        s.padded.setZero(Eigen::Index(plane) * C);
+        for (int c = 0; c < C; ++c) {
+            for (int y = 0; y < H; ++y) {
+                float *dst = s.padded.data() + c * plane + (y + 1) * Wp + 1;
+                const uint8_t *src = pixels + y * W * C + c;
+                for (int x = 0; x < W; ++x) dst[x] = float(src[x * C]);
+            }
+        }
+        s.value.resize(Eigen::Index(n) * C);
+        for (int c = 0; c < C; ++c) {
+            const float *src = s.padded.data() + c * plane;
+            for (int p = 0; p < n; ++p) { // 4-tap gather, then the blend
+                const float *t = src + s.base(p);
+                const float top = t[0] + s.fx(p) * (t[1] - t[0]), bottom = t[Wp] + s.fx(p) * (t[Wp + 1] - t[Wp]);
+                s.value(p * C + c) = top + s.fy(p) * (bottom - top);
+            }
+        }
+    }
+
+    if (augment_noise > 0.0f) { // sum of four 16-bit uniforms: variance 1/3 of U(-1/2, 1/2) each, tails cut at 3.5 sigma
+        const uint32_t noiseKey = mix32(key ^ 0x9E3779B9u);
+        const float amplitude = augment_noise * 255.0f * std::sqrt(3.0f) / 65536.0f;
+        float *value = s.value.data();
+        for (int j = 0; j < n * C; ++j) {
+            const uint32_t h1 = mix32(noiseKey + 2 * uint32_t(j)), h2 = mix32(noiseKey + 2 * uint32_t(j) + 1);
+            const int32_t sum = int32_t((h1 & 0xffffU) + (h1 >> 16) + (h2 & 0xffffU) + (h2 >> 16)) - 2 * 65535;
+            value[j] += amplitude * float(sum);
+        }
+    }
+    image = (s.value + 0.5f).cwiseMax(0.0f).cwiseMin(255.0f).cast<uint8_t>(); // round, saturate
+}
+
+void augment_batch(MatrixXu8 &X, const ImageShape &shape, uint64_t seed, ThreadPool &pool)
+{
+    if (!augment_enabled() || X.rows() == 0) return;
+    if (X.cols() != shape.dim()) {
+        std::cerr << "ERROR: augment_batch: rows of " << X.cols() << " pixels, shape has " << shape.dim() << "\n";
+        return;
+    }
+    const PixelGrid grid(shape, augment_elastic_cell);
+    const uint32_t batchKey = mix32(uint32_t(seed) ^ mix32(uint32_t(seed >> 32)));
+    pool.parallelForRows(long(X.rows()), 8, [&](long begin, long end) {
+        Scratch scratch;
+        for (long r = begin; r < end; ++r) augment_image(X.row(r).data(), shape, grid, mix32(batchKey + uint32_t(r) * 0x9E3779B9u), scratch);
+    });
+}
@@ -0,0 +1,37 @@
+#ifndef AUGMENT_H
+#define AUGMENT_H
+
+#include "image_io.h"   // ImageShape
+#include "network.h"    // MatrixXu8
+#include "thread_pool.h"
+#include <cstdint>
+#include <string>
+
+// ====== SETTINGS ======
+// On-the-fly augmentation of training batches (make_batch_u8); every setting 0 = that stage off,
+// all 0 = batches exactly as sampled. Each image draws its own parameters uniformly in range.
+extern float augment_shift;        // max |translation| in pixels, sub-pixel
+extern float augment_rotate;       // max |rotation| in degrees, about the image centre
+extern float augment_scale;        // max relative zoom: scale in [1 - s, 1 + s]
+extern float augment_elastic;      // elastic distortion: max displacement in pixels (Simard et al. 2003)
+extern float augment_elastic_cell; // spacing in pixels of the random displacements smoothly interpolated between
+extern float augment_noise;        // stddev of additive near-Gaussian pixel noise, in [0,1] intensity units
+
+bool augment_enabled();
+
+/**
+ * @brief Sets the augment_* settings from "shift=P,rotate=DEG,scale=F,elastic=P,cell=P,noise=S"
+ * @brief (any subset, comma separated), or "off". Prints an ERROR and returns false on a bad spec.
+ */
+bool set_augment(const std::string &spec);
+
+/**
+ * @brief Augments every row of X in place: one bilinear resampling for the affine transform
+ * @brief (shift, rotation, scale) and the elastic field together, then noise, then back to u8.
+ * @brief Rows are spread over the pool. The random numbers are a counter-based hash of
+ * @brief (seed, row, pixel), so the result depends on the seed only, not on threads or timing.
+ * @param X REFERENCE : images in shape's layout, one per row.
+ */
+void augment_batch(MatrixXu8 &X, const ImageShape &shape, uint64_t seed, ThreadPool &pool = global_pool());
+
+#endif // AUGMENT_H
@@ -0,0 +1,239 @@
+#include "bench.h"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <regex>
+#include <sstream>
+#include <thread>
+
+namespace bench {
+
+// ------------------------------------------------------------
+// State
+// ------------------------------------------------------------
+State::State(int64_t iterations, const std::vector<int64_t> &args) : maxIterations(iterations), args(args) {}
+
+State::Iterator State::begin()
+{
+    StartTimer();
+    return Iterator(this, maxIterations);
+}
+
+void State::StartTimer()
+{
+    running = true;
+    realStart = std::chrono::steady_clock::now();
+    cpuStart = std::clock();
+}
+
+void State::StopTimer()
+{
+    if (!running) return;
+    realSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - realStart).count();
+    cpuSeconds += double(std::clock() - cpuStart) / CLOCKS_PER_SEC;
+    running = false;
+}
+
+void State::PauseTiming() { StopTimer(); }
+void State::ResumeTiming() { StartTimer(); }
+
+
+// ------------------------------------------------------------
+// Registry
+// ------------------------------------------------------------
+static std::vector<std::unique_ptr<Benchmark>> &registry()
+{
+    static std::vector<std::unique_ptr<Benchmark>> r;
+    return r;
+}
+
+Benchmark *RegisterBenchmark(const char *name, std::function<void(State &)> fn)
+{
+    registry().push_back(std::make_unique<Benchmark>(name, std::move(fn)));
+    return registry().back().get();
+}
+
+Benchmark *Benchmark::Args(const std::vector<int64_t> &a)
+{
+    argSets.push_back(a);
+    return this;
+}
+
+Benchmark *Benchmark::ArgsProduct(const std::vector<std::vector<int64_t>> &axes)
+{
+    std::vector<std::vector<int64_t>> out{{}};
+    for (const auto &axis : axes) {
+        std::vector<std::vector<int64_t>> next;
+        for (const auto &prefix : out)
+            for (int64_t v : axis) {
+                next.push_back(prefix);
+                next.back().push_back(v);
+            }
+        out.swap(next);
+    }
+    argSets.insert(argSets.end(), out.begin(), out.end());
+    return this;
+}
+
+Benchmark *Benchmark::ArgNames(const std::vector<std::string> &names)
+{
+    argNames = names;
+    return this;
+}
+
+
+// ------------------------------------------------------------
+// Runner
+// ------------------------------------------------------------
+struct Result
+{
+    std::string name;
+    int64_t iterations;
+    double realNs; // per iteration
+    double cpuNs;
+    double itemsPerSecond;
+    double bytesPerSecond;
+    std::map<std::string, double> counters;
+    std::string error;
+};
+
+static std::string runName(const Benchmark &b, const std::vector<int64_t> &args)
+{
+    std::ostringstream s;
+    s << b.name;
+    for (size_t i = 0; i < args.size(); ++i) {
+        s << "/";
+        if (i < b.argNames.size()) s << b.argNames[i] << ":";
+        s << args[i];
+    }
+    return s.str();
+}
+
+static Result runOne(const Benchmark &b, const std::vector<int64_t> &args, double minTime)
+{
+    // Grow the iteration count until one run lasts at least minTime, like Google Benchmark.
+    int64_t iters = 1;
+    for (;;) {
+        State state(iters, args);
+        b.fn(state);
+        const bool done = state.realSeconds >= minTime || iters >= 1000000000 || !state.error.empty();
+        if (done) {
+            Result r;
+            r.name = runName(b, args);
+            r.iterations = iters;
+            r.realNs = state.realSeconds * 1e9 / double(iters);
+            r.cpuNs = state.cpuSeconds * 1e9 / double(iters);
+            r.itemsPerSecond = state.realSeconds > 0 ? state.itemsProcessed / state.realSeconds : 0.0;
+            r.bytesPerSecond = state.realSeconds > 0 ? state.bytesProcessed / state.realSeconds : 0.0;
+            r.counters = state.counters;
+            r.error = state.error;
+            return r;
+        }
+        double predicted = state.realSeconds > 0 ? 1.4 * minTime / state.realSeconds * double(iters) : 10.0 * double(iters);
+        iters = std::max<int64_t>(iters + 1, std::min<int64_t>(int64_t(predicted), iters * 100));
+    }
+}
+
+static std::string jsonEscape(const std::string &s)
+{
+    std::string out;
+    for (char c : s) {
+        if (c == '"' || c == '\\') out += '\\';
+        out += c;
+    }
+    return out;
+}
+
+static void writeJson(const std::string &path, const std::vector<Result> &results)
+{
+    std::ofstream f(path);
+    if (!f) {
+        std::cerr << "ERROR: cannot write " << path << "\n";
+        return;
+    }
+    std::time_t now = std::time(nullptr);
+    char date[64];
+    std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", std::localtime(&now));
+
+    f << "{\n  \"context\": {\n";
+    f << "    \"date\": \"" << date << "\",\n";
+    f << "    \"num_cpus\": " << std::thread::hardware_concurrency() << ",\n";
+#ifdef NDEBUG
+    f << "    \"library_build_type\": \"release\"\n";
+#else
+    f << "    \"library_build_type\": \"debug\"\n";
+#endif
+    f << "  },\n  \"benchmarks\": [\n";
+    f << std::setprecision(10);
+    for (size_t i = 0; i < results.size(); ++i) {
+        const Result &r = results[i];
+        f << "    {\n";
+        f << "      \"name\": \"" << jsonEscape(r.name) << "\",\n";
+        if (!r.error.empty()) f << "      \"error_message\": \"" << jsonEscape(r.error) << "\",\n";
+        f << "      \"iterations\": " << r.iterations << ",\n";
+        f << "      \"real_time\": " << r.realNs << ",\n";
+        f << "      \"cpu_time\": " << r.cpuNs << ",\n";
+        f << "      \"time_unit\": \"ns\"";
+        if (r.itemsPerSecond > 0) f << ",\n      \"items_per_second\": " << r.itemsPerSecond;
+        if (r.bytesPerSecond > 0) f << ",\n      \"bytes_per_second\": " << r.bytesPerSecond;
+        for (const auto &c : r.counters) f << ",\n      \"" << jsonEscape(c.first) << "\": " << c.second;
+        f << "\n    }" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    f << "  ]\n}\n";
+}
+
+int RunSpecifiedBenchmarks(int argc, char **argv)
+{
+    std::string filter = ".*";
+    std::string outPath;
+    double minTime = 0.5;
+    for (int i = 1; i < argc; ++i) {
+        std::string a = argv[i];
+        auto value = [&](const char *flag) { return a.substr(std::string(flag).size()); };
+        if (a.rfind("--benchmark_filter=", 0) == 0) filter = value("--benchmark_filter=");
+        else if (a.rfind("--benchmark_out=", 0) == 0) outPath = value("--benchmark_out=");
+        else if (a.rfind("--benchmark_min_time=", 0) == 0) minTime = std::stod(value("--benchmark_min_time="));
+        else {
+            std::cerr << "usage: " << argv[0]
+                      << " [--benchmark_filter=<regex>] [--benchmark_min_time=<s>] [--benchmark_out=<file.json>]\n";
+            return 1;
+        }
+    }
+#ifndef NDEBUG
+    std::cerr << "***WARNING*** benchmarks built without NDEBUG; use `make bench BUILD=release`\n";
+#endif
+
+    const std::regex re(filter);
+    std::vector<Result> results;
+    std::printf("%-52s %14s %14s %12s  %s\n", "Benchmark", "Time(ns)", "CPU(ns)", "Iterations", "Rate");
+    for (const auto &b : registry()) {
+        std::vector<std::vector<int64_t>> sets = b->argSets.empty() ? std::vector<std::vector<int64_t>>{{}} : b->argSets;
+        for (const auto &args : sets) {
+            if (!std::regex_search(runName(*b, args), re)) continue;
+            Result r = runOne(*b, args, minTime);
+            if (!r.error.empty()) {
+                std::printf("%-52s ERROR: %s\n", r.name.c_str(), r.error.c_str());
+            } else {
+                std::printf("%-52s %14.0f %14.0f %12lld", r.name.c_str(), r.realNs, r.cpuNs, (long long)r.iterations);
+                if (r.itemsPerSecond > 0) std::printf("  %.4g items/s", r.itemsPerSecond);
+                if (r.bytesPerSecond > 0) std::printf("  %.4g B/s", r.bytesPerSecond);
+                for (const auto &c : r.counters) std::printf("  %s=%.4g", c.first.c_str(), c.second);
+                std::printf("\n");
+            }
+            std::fflush(stdout);
+            results.push_back(r);
+        }
+    }
+    if (!outPath.empty()) writeJson(outPath, results);
+    return 0;
+}
+
+} // namespace bench
+
+int main(int argc, char **argv)
+{
+    return bench::RunSpecifiedBenchmarks(argc, argv);
+}
@@ -0,0 +1,120 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+// Minimal Google-Benchmark-style harness, so the bench target needs nothing beyond Eigen.
+//
+//   static void BM_thing(bench::State &state) {
+//       setup(state.range(0));
+//       for (auto _ : state) { bench::DoNotOptimize(work()); }
+//       state.SetItemsProcessed(state.iterations() * n);
+//   }
+//   BENCHMARK(BM_thing)->ArgNames({"B"})->Args({64})->Args({256});
+//
+// Flags: --benchmark_filter=<regex>  --benchmark_min_time=<seconds>  --benchmark_out=<file.json>
+
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace bench {
+
+template <class T>
+inline void DoNotOptimize(T const &value)
+{
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+inline void ClobberMemory()
+{
+    asm volatile("" : : : "memory");
+}
+
+class State
+{
+public:
+    State(int64_t iterations, const std::vector<int64_t> &args);
+
+    struct [[maybe_unused]] Value {};
+    class Iterator
+    {
+    public:
+        Iterator(State *state, int64_t left) : state(state), left(left) {}
+        bool operator!=(const Iterator &) const
+        {
+            if (left > 0) return true;
+            state->StopTimer();
+            return false;
+        }
+        Iterator &operator++()
+        {
+            --left;
+            return *this;
+        }
+        Value operator*() const { return Value(); }
+
+    private:
+        State *state;
+        int64_t left;
+    };
+    Iterator begin();
+    Iterator end() { return Iterator(this, 0); }
+
+    int64_t range(size_t i = 0) const { return args.at(i); }
+    int64_t iterations() const { return maxIterations; }
+
+    void PauseTiming();
+    void ResumeTiming();
+    void SetItemsProcessed(int64_t n) { itemsProcessed = n; }
+    void SetBytesProcessed(int64_t n) { bytesProcessed = n; }
+    void SkipWithError(const std::string &msg) { error = msg; }
+
+    std::map<std::string, double> counters; // reported as-is (per run, not per iteration)
+
+    // filled in by the runner
+    double realSeconds = 0.0;
+    double cpuSeconds = 0.0;
+    int64_t itemsProcessed = 0;
+    int64_t bytesProcessed = 0;
+    std::string error;
+
+private:
+    void StartTimer();
+    void StopTimer();
+
+    int64_t maxIterations;
+    std::vector<int64_t> args;
+    bool running = false;
+    std::chrono::steady_clock::time_point realStart;
+    std::clock_t cpuStart = 0;
+};
+
+class Benchmark
+{
+public:
+    Benchmark(std::string name, std::function<void(State &)> fn) : name(std::move(name)), fn(std::move(fn)) {}
+
+    Benchmark *Args(const std::vector<int64_t> &a);
+    Benchmark *ArgsProduct(const std::vector<std::vector<int64_t>> &axes);
+    Benchmark *ArgNames(const std::vector<std::string> &names);
+
+    std::string name;
+    std::function<void(State &)> fn;
+    std::vector<std::vector<int64_t>> argSets;
+    std::vector<std::string> argNames;
+};
+
+Benchmark *RegisterBenchmark(const char *name, std::function<void(State &)> fn);
+int RunSpecifiedBenchmarks(int argc, char **argv);
+
+} // namespace bench
+
+#define BENCH_CONCAT2(a, b) a##b
+#define BENCH_CONCAT(a, b) BENCH_CONCAT2(a, b)
+#define BENCHMARK(fn) \
+    static ::bench::Benchmark *BENCH_CONCAT(bench_registration_, __LINE__) = ::bench::RegisterBenchmark(#fn, fn)
+
+#endif // BENCH_H
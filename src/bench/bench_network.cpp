@@ -0,0 +1,513 @@
+#include "bench.h"
+#include "../network.h"
+#include "../shape.h"
+#include "../train.h"
+#include "../eval.h"
+#include "../weight_store.h"
+#include "../latent.h"
+#include "../latent_index.h"
+#include "../anomaly.h"
+#include "../bundle.h"
+#include "../augment.h"
+#include <cstdio>
+#include <random>
+
+// Sweeps used by every kernel benchmark: batch size, hidden width, input width.
+static const std::vector<int64_t> kB = {16, 64, 256};
+static const std::vector<int64_t> kH = {32, 128, 512};
+static const std::vector<int64_t> kD = {256, 784};
+
+/**
+ * @brief Sets the global B / H_size / D for one benchmark run and restores them afterwards,
+ * @brief since Weights, ForwardOutput and Gradients size themselves from those globals.
+ */
+struct ScopedShape
+{
+    int oldB = B, oldH = H_size, oldD = D;
+    ScopedShape(int64_t b, int64_t h, int64_t d)
+    {
+        B = int(b);
+        H_size = int(h);
+        D = int(d);
+    }
+    ~ScopedShape()
+    {
+        B = oldB;
+        H_size = oldH;
+        D = oldD;
+    }
+};
+
+static MatrixXfRow random_batch(int rows, int cols)
+{
+    return (MatrixXfRow::Random(rows, cols).array() * 0.5f + 0.5f).matrix(); // pixels in [0,1]
+}
+
+// ------------------------------------------------------------
+// Kernels
+// ------------------------------------------------------------
+static void BM_forwardPass(bench::State &state)
+{
+    ScopedShape shape(state.range(0), state.range(1), state.range(2));
+    Weights weights;
+    ForwardOutput forward;
+    MatrixXfRow X = random_batch(B, D);
+    for (auto _ : state) {
+        forwardPass(forward, weights, X);
+        bench::DoNotOptimize(forward.loss);
+    }
+    state.SetItemsProcessed(state.iterations() * B);
+}
+BENCHMARK(BM_forwardPass)->ArgNames({"B", "H", "D"})->ArgsProduct({kB, kH, kD});
+
+static void BM_backPass(bench::State &state)
+{
+    ScopedShape shape(state.range(0), state.range(1), state.range(2));
+    Weights weights;
+    ForwardOutput forward;
+    Gradients gradients;
+    MatrixXfRow X = random_batch(B, D);
+    forwardPass(forward, weights, X);
+    for (auto _ : state) {
+        backPass(gradients, forward, weights, X);
+        bench::DoNotOptimize(gradients.Gw1.data());
+        bench::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * B);
+}
+BENCHMARK(BM_backPass)->ArgNames({"B", "H", "D"})->ArgsProduct({kB, kH, kD});
+
+// tile = 0 runs the unfused backward (Gy, Ga2, Gh stored whole, each reread by the next pass).
+// gy_traffic_MB: bytes of stored output-layer gradient moved per step (Gy written once and read
+// by the Gw3 GEMM, the Gb3 sum and the Ga2 GEMM); the fused sweep keeps each tile in cache.
+static void BM_backPass_fused(bench::State &state)
+{
+    ScopedShape shape(state.range(0), 128, 784);
+    const bool oldFused = fused_backward;
+    const int oldTile = backward_tile_cols;
+    fused_backward = state.range(1) > 0;
+    backward_tile_cols = fused_backward ? int(state.range(1)) : oldTile;
+    Weights weights;
+    ForwardOutput forward;
+    Gradients gradients;
+    MatrixXfRow X = random_batch(B, D);
+    forwardPass(forward, weights, X);
+    for (auto _ : state) {
+        backPass(gradients, forward, weights, X);
+        bench::DoNotOptimize(gradients.Gw1.data());
+        bench::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * B);
+    state.counters["gy_traffic_MB"] = fused_backward ? 0.0 : 4.0 * B * D * sizeof(float) / 1e6;
+    fused_backward = oldFused;
+    backward_tile_cols = oldTile;
+}
+BENCHMARK(BM_backPass_fused)->ArgNames({"B", "tile"})->ArgsProduct({{64, 256}, {0, 16, 32, 64, 128, 784}});
+
+static void BM_backProp(bench::State &state)
+{
+    ScopedShape shape(64, state.range(0), state.range(1)); // the update does not depend on B
+    Weights weights;
+    ForwardOutput forward;
+    Gradients gradients;
+    MatrixXfRow X = random_batch(B, D);
+    forwardPass(forward, weights, X);
+    backPass(gradients, forward, weights, X);
+    for (auto _ : state) {
+        backProp(weights, gradients);
+        bench::DoNotOptimize(weights.W1.data());
+        bench::ClobberMemory();
+    }
+    const int64_t params = int64_t(D) * H_size * 2 + int64_t(H_size) * H_size + 2 * H_size + D;
+    state.SetBytesProcessed(state.iterations() * params * int64_t(3 * sizeof(float))); // read W, read G, write W
+}
+BENCHMARK(BM_backProp)->ArgNames({"H", "D"})->ArgsProduct({kH, kD});
+
+// Backward + SGD update: backPass() then backProp() (fused:0) vs backPassUpdate() (fused:1).
+// grad_MB is what the Gradients buffers hold; without Gw1/Gw2/Gw3 only activation-sized ones remain.
+static void BM_backward_update(bench::State &state)
+{
+    ScopedShape shape(state.range(0), 128, 784);
+    const bool fused = state.range(1) != 0;
+    Weights weights;
+    ForwardOutput forward;
+    Gradients gradients(!fused);
+    MatrixXfRow X = random_batch(B, D);
+    forwardPass(forward, weights, X);
+    for (auto _ : state) {
+        if (fused) {
+            backPassUpdate(weights, gradients, forward, X);
+        } else {
+            backPass(gradients, forward, weights, X);
+            backProp(weights, gradients);
+        }
+        bench::DoNotOptimize(weights.W1.data());
+        bench::ClobberMemory();
+    }
+    auto bytes = [](const auto &m) { return double(m.size()) * sizeof(float); };
+    state.SetItemsProcessed(state.iterations() * B);
+    state.counters["grad_MB"] = (bytes(gradients.Gy) + bytes(gradients.Ga2) + bytes(gradients.Gz2) + bytes(gradients.Gh) +
+                                 bytes(gradients.Gz) + bytes(gradients.Gw1) + bytes(gradients.Gw2) + bytes(gradients.Gw3) +
+                                 bytes(gradients.tile)) / 1e6;
+}
+BENCHMARK(BM_backward_update)->ArgNames({"B", "fused"})->ArgsProduct({kB, {0, 1}});
+
+// Memory vs time of the activation plan: a full step (forward + backPassUpdate) keeping the
+// (B, D) output (keep:1) or recomputing it tile by tile in the backward (keep:0).
+static void BM_activation_plan(bench::State &state)
+{
+    ScopedShape shape(state.range(0), state.range(1), 784);
+    const bool keep = state.range(2) != 0;
+    Weights weights;
+    ForwardOutput forward(keep);
+    Gradients scratch(false);
+    MatrixXfRow X = random_batch(B, D);
+    for (auto _ : state) {
+        forwardPass(forward, weights, X);
+        backPassUpdate(weights, scratch, forward, X);
+        bench::DoNotOptimize(forward.loss);
+    }
+    state.SetItemsProcessed(state.iterations() * B);
+    state.counters["activation_MB"] = activation_bytes(B, keep) / 1e6;
+}
+BENCHMARK(BM_activation_plan)->ArgNames({"B", "H", "keep"})->ArgsProduct({{64, 256, 1024}, {128, 512}, {1, 0}});
+
+// ------------------------------------------------------------
+// Data path (needs the MNIST files, like main)
+// ------------------------------------------------------------
+static void BM_make_batch(bench::State &state)
+{
+    std::mt19937 rng(1337u);
+    const int b = int(state.range(0));
+    make_batch(b, rng, true); // lazy load outside the timed loop
+    for (auto _ : state) {
+        MatrixXfRow X = make_batch(b, rng, true);
+        bench::DoNotOptimize(X.data());
+    }
+    state.SetItemsProcessed(state.iterations() * b);
+}
+BENCHMARK(BM_make_batch)->ArgNames({"B"})->ArgsProduct({kB});
+
+static void BM_make_batch_u8(bench::State &state)
+{
+    std::mt19937 rng(1337u);
+    const int b = int(state.range(0));
+    make_batch_u8(b, rng, true);
+    for (auto _ : state) {
+        MatrixXu8 X = make_batch_u8(b, rng, true);
+        bench::DoNotOptimize(X.data());
+    }
+    state.SetItemsProcessed(state.iterations() * b);
+    state.SetBytesProcessed(state.iterations() * b * 784);
+}
+BENCHMARK(BM_make_batch_u8)->ArgNames({"B"})->ArgsProduct({kB});
+
+// stages: 0 none, 1 shift + rotation + scale, 2 and elastic, 3 and noise
+static void BM_make_batch_augmented(bench::State &state)
+{
+    const int b = int(state.range(0));
+    const char *specs[] = {"off", "shift=2,rotate=10,scale=0.1", "shift=2,rotate=10,scale=0.1,elastic=1.5",
+                           "shift=2,rotate=10,scale=0.1,elastic=1.5,noise=0.05"};
+    set_augment(specs[state.range(1)]);
+    std::mt19937 rng(1337u);
+    SparseBatch Xs;
+    make_batch_u8(b, rng, true);
+    for (auto _ : state) {
+        MatrixXu8 X = make_batch_u8(b, rng, true, &Xs);
+        bench::DoNotOptimize(X.data());
+    }
+    set_augment("off");
+    state.SetItemsProcessed(state.iterations() * b);
+}
+BENCHMARK(BM_make_batch_augmented)->ArgNames({"B", "stages"})->ArgsProduct({{64, 256}, {0, 1, 2, 3}});
+
+static void BM_forwardPass_u8(bench::State &state)
+{
+    ScopedShape shape(state.range(0), state.range(1), 784);
+    Weights weights;
+    ForwardOutput forward;
+    MatrixXu8 X = (random_batch(B, D) * 255.0f).cast<uint8_t>();
+    for (auto _ : state) {
+        forwardPass(forward, weights, X);
+        bench::DoNotOptimize(forward.loss);
+    }
+    state.SetItemsProcessed(state.iterations() * B);
+}
+BENCHMARK(BM_forwardPass_u8)->ArgNames({"B", "H"})->ArgsProduct({kB, kH});
+
+static void BM_write_png_grid(bench::State &state)
+{
+    const int grid = int(state.range(0));
+    ImageWriteOptions opts;
+    opts.format = ImageFormat(state.range(1));
+    opts.threads = int(state.range(2));
+    MatrixXfRow X = random_batch(grid * grid, 784);
+    const std::string path = opts.format == ImageFormat::Pgm ? "bench_grid.pgm" : "bench_grid.png";
+    for (auto _ : state) {
+        if (!write_png_grid(X, grid, grid, path, opts)) {
+            state.SkipWithError("cannot write " + path);
+            break;
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * grid * grid);
+    std::remove(path.c_str());
+}
+// format: 0 Pgm, 1 PngStored, 2 PngFast, 3 PngParallel, 4 PngStb; threads: PngParallel chunks, 0 = pool size.
+// A single 28-row tile with more chunks than rows covers the uneven chunking (run it in the debug build).
+BENCHMARK(BM_write_png_grid)->ArgNames({"grid", "format", "threads"})->ArgsProduct({{4, 32}, {0, 1, 2, 3, 4}, {0}})->Args({1, 3, 16})->Args({1, 3, 64});
+
+// ------------------------------------------------------------
+// End to end: batch + forward + backward + update, as in main()
+// ------------------------------------------------------------
+static void BM_train_step(bench::State &state)
+{
+    ScopedShape shape(state.range(0), state.range(1), 784);
+    std::mt19937 rng(1337u);
+    Weights weights;
+    ForwardOutput forward;
+    Gradients gradients;
+    SparseBatch Xs;
+    MatrixXu8 X = make_batch_u8(B, rng, true);
+    for (auto _ : state) {
+        X = make_batch_u8(B, rng, true, &Xs);
+        const SparseBatch *sparse = useSparseInput(Xs) ? &Xs : nullptr;
+        forwardPass(forward, weights, X, sparse);
+        backPass(gradients, forward, weights, X, sparse);
+        backProp(weights, gradients);
+    }
+    bench::DoNotOptimize(forward.loss);
+    state.SetItemsProcessed(state.iterations() * B);
+    state.counters["steps_per_second"] = state.realSeconds > 0 ? double(state.iterations()) / state.realSeconds : 0.0;
+}
+BENCHMARK(BM_train_step)->ArgNames({"B", "H"})->ArgsProduct({kB, kH});
+
+// ------------------------------------------------------------
+// First layer, dense GEMM vs CSR input, by pixel density (percent)
+// ------------------------------------------------------------
+static MatrixXfRow sparse_batch(int rows, int cols, int densityPercent)
+{
+    Eigen::ArrayXXf keep = (Eigen::ArrayXXf::Random(rows, cols).abs() < densityPercent / 100.0f).cast<float>();
+    return (keep * (Eigen::ArrayXXf::Random(rows, cols).abs() * 0.9f + 0.1f)).matrix();
+}
+
+static void BM_first_layer_forward(bench::State &state)
+{
+    Weights weights;
+    MatrixXfRow X = sparse_batch(B, D, int(state.range(0)));
+    SparseBatch Xs = X.sparseView();
+    const bool sparse = state.range(1) != 0;
+    MatrixXfRow Z(B, H_size);
+    for (auto _ : state) {
+        if (sparse)
+            Z.noalias() = Xs * weights.W1;
+        else
+            Z.noalias() = X * weights.W1;
+        bench::DoNotOptimize(Z.data());
+        bench::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * B);
+}
+BENCHMARK(BM_first_layer_forward)->ArgNames({"density%", "sparse"})->ArgsProduct({{5, 15, 30, 50}, {0, 1}});
+
+static void BM_first_layer_grad(bench::State &state)
+{
+    MatrixXfRow X = sparse_batch(B, D, int(state.range(0)));
+    SparseBatch Xs = X.sparseView();
+    const bool sparse = state.range(1) != 0;
+    MatrixXfRow Gz = MatrixXfRow::Random(B, H_size);
+    MatrixXfRow Gw1(D, H_size);
+    for (auto _ : state) {
+        if (sparse)
+            Gw1.noalias() = Xs.transpose() * Gz;
+        else
+            Gw1.noalias() = X.transpose() * Gz;
+        bench::DoNotOptimize(Gw1.data());
+        bench::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * B);
+}
+BENCHMARK(BM_first_layer_grad)->ArgNames({"density%", "sparse"})->ArgsProduct({{5, 15, 30, 50}, {0, 1}});
+
+// ------------------------------------------------------------
+// Gradient accumulation: K micro-batches of B per update, on a pool of T workers
+// ------------------------------------------------------------
+static void BM_accumulated_step(bench::State &state)
+{
+    ScopedShape shape(64, 128, 784);
+    const int K = int(state.range(0));
+    ThreadPool pool(int(state.range(1)));
+    Trainer trainer(pool, K, 1337u);
+    Weights weights;
+    trainer.step(weights); // loads MNIST, sizes every buffer
+    for (auto _ : state) {
+        bench::DoNotOptimize(trainer.step(weights));
+    }
+    state.SetItemsProcessed(state.iterations() * K * B);
+    state.counters["effective_batch"] = K * B;
+    state.counters["workspace_MB"] = trainer.workspaceBytes() / 1e6;
+}
+BENCHMARK(BM_accumulated_step)->ArgNames({"K", "workers"})->ArgsProduct({{1, 4, 16}, {1, 3, 7}});
+
+// ------------------------------------------------------------
+// Model bundle: M models of width H on one shared batch per step, against M separate steps
+// ------------------------------------------------------------
+static void BM_bundle_step(bench::State &state)
+{
+    ScopedShape shape(64, 32, 784);
+    const int M = int(state.range(0));
+    std::vector<Weights> models(static_cast<size_t>(M));
+    std::mt19937 rng(1337u);
+    if (state.range(1)) {
+        BundleWeights bundle(models, {});
+        BundleTrainer trainer(global_pool(), 1337u);
+        for (auto _ : state) {
+            trainer.step(bundle);
+            bench::DoNotOptimize(trainer.losses().data());
+        }
+    } else {
+        ForwardOutput forward;
+        Gradients gradients;
+        SparseBatch Xs;
+        for (auto _ : state) {
+            for (Weights &weights : models) {
+                MatrixXu8 X = make_batch_u8(B, rng, true, &Xs);
+                const SparseBatch *sparse = useSparseInput(Xs) ? &Xs : nullptr;
+                forwardPass(forward, weights, X, sparse);
+                backPass(gradients, forward, weights, X, sparse);
+                backProp(weights, gradients);
+            }
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * M * B);
+}
+BENCHMARK(BM_bundle_step)->ArgNames({"M", "bundled"})->ArgsProduct({{1, 4, 16}, {0, 1}});
+
+// ------------------------------------------------------------
+// Full test-set pass: 10k images in eval_batch-row blocks on a pool of T workers
+// ------------------------------------------------------------
+static void BM_evaluate(bench::State &state)
+{
+    ScopedShape shape(64, 128, 784);
+    const int oldBatch = eval_batch;
+    eval_batch = int(state.range(0));
+    ThreadPool pool(int(state.range(1)));
+    Weights weights;
+    size_t images = evaluate(weights, false, pool).images; // loads MNIST
+    for (auto _ : state) {
+        bench::DoNotOptimize(evaluate(weights, false, pool).bce);
+    }
+    eval_batch = oldBatch;
+    state.SetItemsProcessed(state.iterations() * int64_t(images));
+}
+BENCHMARK(BM_evaluate)->ArgNames({"batch", "workers"})->ArgsProduct({{100, 500, 2500}, {1, 3, 7}});
+
+// ------------------------------------------------------------
+// Weight publication: copy + swap on the trainer side, pin + unpin on the reader side
+// ------------------------------------------------------------
+static void BM_weight_publish(bench::State &state)
+{
+    ScopedShape shape(64, state.range(0), 784);
+    WeightPublisher publisher;
+    Weights weights;
+    size_t i = 0;
+    for (auto _ : state) {
+        bench::DoNotOptimize(publisher.publish(weights, i++));
+    }
+    state.SetBytesProcessed(state.iterations() * int64_t(weights.W1.size() + weights.W2.size() + weights.W3.size()) *
+                            int64_t(sizeof(float)));
+}
+BENCHMARK(BM_weight_publish)->ArgNames({"H"})->ArgsProduct({kH});
+
+static void BM_weight_acquire(bench::State &state)
+{
+    ScopedShape shape(64, 128, 784);
+    WeightPublisher publisher;
+    publisher.publish(Weights(), 0);
+    for (auto _ : state) {
+        WeightPublisher::Reader pinned = publisher.acquire();
+        bench::DoNotOptimize(pinned.weights().W1.data());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_weight_acquire);
+
+// ------------------------------------------------------------
+// Inference-only decoder: 4096 latents in decode_batch-row blocks
+// ------------------------------------------------------------
+static void BM_decode(bench::State &state)
+{
+    ScopedShape shape(64, state.range(1), 784);
+    const int oldBatch = decode_batch;
+    decode_batch = int(state.range(0));
+    Weights weights;
+    const MatrixXfRow latents = MatrixXfRow::Random(4096, H_size);
+    MatrixXfRow images;
+    for (auto _ : state) {
+        decode(weights, latents, images);
+        bench::DoNotOptimize(images.data());
+    }
+    decode_batch = oldBatch;
+    state.SetItemsProcessed(state.iterations() * latents.rows());
+}
+BENCHMARK(BM_decode)->ArgNames({"batch", "H"})->ArgsProduct({{16, 64, 128, 512, 4096}, {32, 128}});
+
+// ------------------------------------------------------------
+// Latent k-NN: 20k random 128-d codes, 256 queries, k = 10
+// ------------------------------------------------------------
+static void BM_knn_flat(bench::State &state)
+{
+    const int oldBlock = knn_query_block;
+    knn_query_block = int(state.range(0));
+    FlatIndex index;
+    index.add(MatrixXfRow::Random(20000, 128));
+    const MatrixXfRow queries = MatrixXfRow::Random(256, 128);
+    for (auto _ : state) {
+        if (knn_query_block == 1) {
+            for (Eigen::Index q = 0; q < queries.rows(); ++q)
+                bench::DoNotOptimize(index.search(Eigen::RowVectorXf(queries.row(q)), 10).data());
+        } else {
+            bench::DoNotOptimize(index.search(queries, 10).data());
+        }
+    }
+    knn_query_block = oldBlock;
+    state.SetItemsProcessed(state.iterations() * queries.rows());
+}
+BENCHMARK(BM_knn_flat)->ArgNames({"query_block"})->ArgsProduct({{1, 16, 64, 256}});
+
+static void BM_knn_ivf(bench::State &state)
+{
+    static const IVFIndex index = [] { // trained once for every nprobe
+        const MatrixXfRow codes = MatrixXfRow::Random(20000, 128);
+        IVFIndex ivf(128);
+        ivf.train(codes);
+        ivf.add(codes);
+        return ivf;
+    }();
+    const MatrixXfRow queries = MatrixXfRow::Random(256, 128);
+    for (auto _ : state) {
+        bench::DoNotOptimize(index.search(queries, 10, int(state.range(0))).data());
+    }
+    state.SetItemsProcessed(state.iterations() * queries.rows());
+}
+BENCHMARK(BM_knn_ivf)->ArgNames({"nprobe"})->ArgsProduct({{1, 4, 16}});
+
+// ------------------------------------------------------------
+// Per-image reconstruction scores, fused from logits, score_batch-row blocks
+// ------------------------------------------------------------
+static void BM_reconstruction_scores(bench::State &state)
+{
+    ScopedShape shape(64, 128, 784);
+    const int oldBatch = score_batch;
+    score_batch = int(state.range(0));
+    Weights weights;
+    MatrixXu8 X;
+    dataset(false).read(0, dataset(false).size(), X);
+    Eigen::VectorXf scores;
+    for (auto _ : state) {
+        reconstruction_scores(weights, X, scores);
+        bench::DoNotOptimize(scores.data());
+    }
+    score_batch = oldBatch;
+    state.SetItemsProcessed(state.iterations() * X.rows());
+}
+BENCHMARK(BM_reconstruction_scores)->ArgNames({"batch"})->ArgsProduct({{64, 256, 1024}});
@@ -0,0 +1,125 @@
+#include "bundle.h"
+#include "profiler.h"
+#include "shape.h"
+#include <iostream>
+
+BundleWeights::BundleWeights(const std::vector<Weights> &models, const std::vector<float> &rates)
+    : offset(1, 0), lr(rates)
+{
+    lr.resize(models.size(), lr.empty() ? float(::lr) : lr.back()); // missing rates repeat the last one
+    for (const Weights &w : models) offset.push_back(offset.back() + int(w.W1.cols()));
+    const Eigen::Index inputs = models.empty() ? D : models[0].W1.rows();
+    W1.resize(inputs, offset.back());
+    b1.resize(offset.back());
+    for (size_t m = 0; m < models.size(); ++m) {
+        W1.middleCols(offset[m], offset[m + 1] - offset[m]) = models[m].W1;
+        b1.segment(offset[m], offset[m + 1] - offset[m]) = models[m].b1;
+        W2.push_back(models[m].W2);
+        b2.push_back(models[m].b2);
+        W3.push_back(models[m].W3);
+        b3.push_back(models[m].b3);
+    }
+}
+
+Weights BundleWeights::extract(int m) const
+{
+    Weights w(int(W1.rows()), hidden(m));
+    w.W1 = W1.middleCols(offset[size_t(m)], hidden(m));
+    w.b1 = b1.segment(offset[size_t(m)], hidden(m));
+    w.W2 = W2[size_t(m)];
+    w.b2 = b2[size_t(m)];
+    w.W3 = W3[size_t(m)];
+    w.b3 = b3[size_t(m)];
+    return w;
+}
+
+
+/**
+ * @brief Output layer of one model, from its logits Z, a row at a time while the row is in L1:
+ * @brief returns the summed BCE, computed as softplus(-z) + (1 - x) z (one exp and one log per
+ * @brief pixel, against one exp and two logs from the sigmoid in forwardPass), and replaces Z by
+ * @brief the gradient (sigmoid(z) - x) / BD.
+ */
+static double output_loss_and_gradient(MatrixXfRow &Z, const MatrixXfRow &x)
+{
+    const float inv = 1.0f / float(B * D);
+    Eigen::Array<float, 1, Eigen::Dynamic> t(Z.cols());
+    double sum = 0.0;
+    for (Eigen::Index i = 0; i < Z.rows(); ++i) {
+        auto z = Z.row(i).array();
+        const auto xr = x.row(i).array();
+        t = (-z.abs()).exp(); // in (0, 1]: no overflow either way
+        sum += ((-z).max(0.0f) + (1 + t).log() + (1 - xr) * z).sum();
+        z = ((z >= 0).select(1.0f, t) / (1 + t) - xr) * inv;
+    }
+    return sum;
+}
+
+BundleTrainer::BundleTrainer(ThreadPool &pool, uint32_t seed) : pool(pool), rng(seed) {}
+
+/**
+ * @brief Layers 2 and 3 of model m: forward from its slice of H, loss, backward, and their SGD
+ * @brief update; leaves lr * dL/dZ1 in its slice of Gz for the shared layer-1 update.
+ */
+void BundleTrainer::modelStep(BundleWeights &weights, int m)
+{
+    ModelState &s = state[size_t(m)];
+    const auto Hm = H.middleCols(weights.offset[size_t(m)], weights.hidden(m));
+    Eigen::MatrixXf &W2 = weights.W2[size_t(m)], &W3 = weights.W3[size_t(m)];
+    const float rate = weights.lr[size_t(m)];
+
+    s.A2.noalias() = Hm * W2;
+    s.A2.rowwise() += weights.b2[size_t(m)];
+    s.A2 = s.A2.array().tanh();
+    s.Gy.noalias() = s.A2 * W3;
+    s.Gy.rowwise() += weights.b3[size_t(m)];
+    loss[size_t(m)] = output_loss_and_gradient(s.Gy, x) / double(s.Gy.size());
+
+    // Every gradient that reads a weight is taken before that weight is updated.
+    s.Gz2.noalias() = s.Gy * W3.transpose();
+    s.Gz2.array() *= 1 - s.A2.array() * s.A2.array();
+    s.Gh.noalias() = s.Gz2 * W2.transpose();
+    Gz.middleCols(weights.offset[size_t(m)], weights.hidden(m)) = rate * (s.Gh.array() * (1 - Hm.array() * Hm.array())).matrix();
+
+    W3.noalias() -= (rate * s.A2.transpose()) * s.Gy;
+    weights.b3[size_t(m)] -= rate * s.Gy.colwise().sum();
+    W2.noalias() -= (rate * Hm.transpose()) * s.Gz2;
+    weights.b2[size_t(m)] -= rate * s.Gz2.colwise().sum();
+}
+
+/**
+ * @brief Draw one batch and take one SGD step on every model of the bundle.
+ * @param weights REFERENCE : updated in place.
+ */
+void BundleTrainer::step(BundleWeights &weights)
+{
+    const int M = weights.models();
+    state.resize(size_t(M));
+    loss.resize(size_t(M));
+    {
+        PROFILE_SCOPE("data");
+        X = make_batch_u8(B, rng, true, &Xs);
+    }
+    const bool sparse = useSparseInput(Xs);
+    x = X.cast<float>() * (1.0f / 255.0f);
+    {
+        PROFILE_SCOPE("bundle.layer1");
+        if (sparse)
+            H.noalias() = Xs * weights.W1;
+        else
+            H.noalias() = x * weights.W1;
+        H.rowwise() += weights.b1;
+        H = H.array().tanh();
+        Gz.resize(H.rows(), H.cols());
+    }
+    {
+        PROFILE_SCOPE("bundle.models");
+        pool.parallelFor(M, [&](int m) { modelStep(weights, m); });
+    }
+    PROFILE_SCOPE("bundle.layer1_update");
+    if (sparse)
+        weights.W1.noalias() -= Xs.transpose() * Gz;
+    else
+        weights.W1.noalias() -= x.transpose() * Gz;
+    weights.b1 -= Gz.colwise().sum();
+}
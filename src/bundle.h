@@ -0,0 +1,67 @@
+#ifndef BUNDLE_H
+#define BUNDLE_H
+
+#include "network.h"
+#include "thread_pool.h"
+#include <random>
+#include <vector>
+
+/**
+ * @brief M independent autoencoders, of any hidden widths, stored to be trained as one.
+ * @brief Every model reads the same input, so their first layers are kept side by side in one
+ * @brief (D, sum of widths) matrix: one GEMM computes every model's H, one GEMM every W1
+ * @brief gradient. Layers 2 and 3 differ per model and stay separate. Each model has its own
+ * @brief learning rate; nothing else is shared.
+ */
+struct BundleWeights
+{
+    MatrixXfRow W1;                    // model m owns columns [offset[m], offset[m + 1])
+    Eigen::RowVectorXf b1;
+    std::vector<Eigen::MatrixXf> W2, W3;
+    std::vector<Eigen::RowVectorXf> b2, b3;
+    std::vector<int> offset;           // M + 1 entries
+    std::vector<float> lr;             // per model
+
+    BundleWeights(const std::vector<Weights> &models, const std::vector<float> &rates);
+    int models() const { return int(W2.size()); }
+    int hidden(int m) const { return offset[size_t(m) + 1] - offset[size_t(m)]; }
+    Weights extract(int m) const; // model m on its own, e.g. for save_checkpoint()
+};
+
+/**
+ * @brief One SGD step = one batch of B samples shared by every model of the bundle:
+ * @brief   1. H for all models: X W1 (one GEMM over the concatenated widths), tanh
+ * @brief   2. per model, in parallel on the pool: layers 2 and 3 forward, loss, backward,
+ * @brief      and their update in place (no weight-gradient buffers, as backPassUpdate())
+ * @brief   3. W1 -= lr X^T Gz for all models (one GEMM; Gz pre-scaled by each model's rate)
+ * @brief Each model gets exactly the update forwardPass + backPass + backProp would give it on
+ * @brief the same batch. Small models underuse the cores one at a time; the shared layer-1 GEMMs
+ * @brief are as wide as one big model, and the per-model layers fill the pool.
+ */
+class BundleTrainer
+{
+public:
+    BundleTrainer(ThreadPool &pool, uint32_t seed);
+
+    void step(BundleWeights &weights);
+    const std::vector<double> &losses() const { return loss; } // per model, last step
+
+private:
+    void modelStep(BundleWeights &weights, int m); // step 2 for model m
+
+    struct ModelState // (B, *) buffers of one model
+    {
+        MatrixXfRow A2, Gy, Gz2, Gh; // Gy holds the output logits, then (sigmoid - x) / BD
+    };
+
+    ThreadPool &pool;
+    std::mt19937 rng;
+    MatrixXu8 X;
+    SparseBatch Xs;
+    MatrixXfRow x;     // X / 255, read by every model's loss and output gradient
+    MatrixXfRow H, Gz; // (B, sum of widths), all models
+    std::vector<ModelState> state;
+    std::vector<double> loss;
+};
+
+#endif // BUNDLE_H
@@ -0,0 +1,410 @@
+#include "dataset.h"
+#include "image_stream.h"
+#include "profiler.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+// ====== SETTINGS ======
+ImageShape raw_shape{28, 28, 1};
+size_t shard_window = 65536;
+size_t shard_window_draws = 0;
+std::string dataset_cache = "";
+
+
+// ------------------------------------------------------------
+// In memory
+// ------------------------------------------------------------
+InMemoryDataset::InMemoryDataset(MatrixXu8 images, const ImageShape &shape) : data(std::move(images))
+{
+    shape_ = shape;
+    size_ = size_t(data.rows());
+}
+
+void InMemoryDataset::sample(int n, std::mt19937 &rng, MatrixXu8 &X)
+{
+    std::uniform_int_distribution<int> U(0, int(data.rows()) - 1);
+    X.resize(n, data.cols());
+    for (int i = 0; i < n; ++i) X.row(i) = data.row(U(rng));
+}
+
+void InMemoryDataset::read(size_t first, size_t n, MatrixXu8 &X) const
+{
+    first = std::min(first, size_);
+    X = data.middleRows(Eigen::Index(first), Eigen::Index(std::min(n, size_ - first)));
+}
+
+
+// ------------------------------------------------------------
+// Memory-mapped cache
+// ------------------------------------------------------------
+struct CacheHeader
+{
+    char magic[8];        // "VAEDSET1"
+    uint64_t fingerprint; // of the source, see source_fingerprint()
+    uint64_t count;
+    uint32_t width, height, channels, reserved;
+    uint64_t dataOffset; // page-aligned start of the pixels
+};
+
+static const char kCacheMagic[8] = {'V', 'A', 'E', 'D', 'S', 'E', 'T', '1'};
+static const uint64_t kCachePage = 4096;
+
+MappedDataset::MappedDataset(const std::string &path, uint64_t fingerprint)
+{
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return; // not built yet
+    struct stat st;
+    CacheHeader h{};
+    const bool readable = fstat(fd, &st) == 0 && size_t(st.st_size) >= sizeof(h) && ::read(fd, &h, sizeof(h)) == ssize_t(sizeof(h));
+    const bool header = readable && std::memcmp(h.magic, kCacheMagic, sizeof(kCacheMagic)) == 0 && h.fingerprint == fingerprint &&
+                        h.dataOffset % kCachePage == 0 && h.dataOffset != 0 && h.dataOffset <= uint64_t(st.st_size) && h.count != 0 &&
+                        h.width != 0 && h.height != 0 && h.channels != 0 && h.width <= 65535 && h.height <= 65535 && h.channels <= 65535;
+    const uint64_t dim = header ? uint64_t(h.width) * h.height * h.channels : 0; // < 2^48, and count * dim <= the file size
+    if (!header || h.count > (uint64_t(st.st_size) - h.dataOffset) / dim || uint64_t(st.st_size) != h.dataOffset + h.count * dim) {
+        std::cerr << "WARNING: ignoring stale or damaged dataset cache " << path << "\n";
+        close(fd);
+        return;
+    }
+    bytes = size_t(st.st_size);
+    void *p = mmap(nullptr, bytes, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd); // the mapping keeps the file
+    if (p == MAP_FAILED) {
+        std::cerr << "WARNING: cannot map dataset cache " << path << ": " << std::strerror(errno) << "\n";
+        return;
+    }
+    madvise(p, bytes, MADV_WILLNEED); // read ahead now rather than fault in page by page during the first batches
+    base = p;
+    pixels = static_cast<const uint8_t *>(base) + h.dataOffset;
+    shape_ = ImageShape{int(h.width), int(h.height), int(h.channels)};
+    size_ = size_t(h.count);
+}
+
+MappedDataset::~MappedDataset()
+{
+    if (base) munmap(base, bytes);
+}
+
+Eigen::Map<const MatrixXu8> MappedDataset::images() const
+{
+    return Eigen::Map<const MatrixXu8>(pixels, Eigen::Index(size_), shape_.dim());
+}
+
+void MappedDataset::sample(int n, std::mt19937 &rng, MatrixXu8 &X)
+{
+    const Eigen::Map<const MatrixXu8> data = images();
+    std::uniform_int_distribution<int> U(0, int(data.rows()) - 1);
+    X.resize(n, data.cols());
+    for (int i = 0; i < n; ++i) X.row(i) = data.row(U(rng));
+}
+
+void MappedDataset::read(size_t first, size_t n, MatrixXu8 &X) const
+{
+    first = std::min(first, size_);
+    X = images().middleRows(Eigen::Index(first), Eigen::Index(std::min(n, size_ - first)));
+}
+
+/**
+ * @brief Write a cache file next to its final name and rename it into place, so a concurrent
+ * @brief reader sees either no file or a complete one; concurrent writers just race to the rename.
+ */
+bool MappedDataset::write(const std::string &path, const InMemoryDataset &source, uint64_t fingerprint)
+{
+    const std::string tmp = path + ".tmp" + std::to_string(getpid());
+    CacheHeader h{};
+    std::memcpy(h.magic, kCacheMagic, sizeof(kCacheMagic));
+    h.fingerprint = fingerprint;
+    h.count = source.size();
+    h.width = uint32_t(source.shape().width);
+    h.height = uint32_t(source.shape().height);
+    h.channels = uint32_t(source.shape().channels);
+    h.dataOffset = kCachePage;
+    {
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        const std::vector<char> pad(size_t(h.dataOffset) - sizeof(h), 0);
+        out.write(reinterpret_cast<const char *>(&h), sizeof(h));
+        out.write(pad.data(), std::streamsize(pad.size()));
+        out.write(reinterpret_cast<const char *>(source.images().data()), std::streamsize(source.images().size())); // rows are contiguous
+        if (!out) {
+            std::cerr << "WARNING: cannot write dataset cache " << tmp << "\n";
+            out.close();
+            std::remove(tmp.c_str());
+            return false;
+        }
+    }
+    std::error_code ec;
+    fs::rename(tmp, path, ec);
+    if (ec) {
+        std::cerr << "WARNING: cannot rename dataset cache to " << path << ": " << ec.message() << "\n";
+        std::remove(tmp.c_str());
+        return false;
+    }
+    return true;
+}
+
+
+// ------------------------------------------------------------
+// Sharded
+// ------------------------------------------------------------
+ShardedDataset::ShardedDataset(std::vector<std::string> shardFiles) : files(std::move(shardFiles))
+{
+    for (const std::string &file : files) {
+        ImageStream s;
+        if (!s.open(file, raw_shape)) return;
+        if (size_ > 0 && s.shape() != shape_) {
+            std::cerr << "ERROR: shard " << file << " has a different image shape\n";
+            return;
+        }
+        shape_ = s.shape();
+        starts.push_back(size_);
+        size_ += s.count();
+    }
+    if (size_ == 0) {
+        std::cerr << "ERROR: no images in the shards\n";
+        return;
+    }
+    current = loadWindow();
+    prefetch();
+}
+
+ShardedDataset::~ShardedDataset()
+{
+    if (loading.valid()) global_pool().wait(loading);
+}
+
+std::shared_ptr<const MatrixXu8> ShardedDataset::loadWindow()
+{
+    PROFILE_SCOPE("data.shard_window");
+    const size_t n = std::min(shard_window, size_);
+    auto window = std::make_shared<MatrixXu8>(Eigen::Index(n), Eigen::Index(shape_.dim()));
+    MatrixXu8 chunk;
+    ImageStream s;
+    size_t filled = 0;
+    while (filled < n) {
+        if (cursorImage == 0 || s.position() != cursorImage) {
+            if (!s.open(files[cursorFile], raw_shape) || !s.seek(cursorImage)) break;
+        }
+        const size_t got = s.next(chunk, n - filled);
+        window->middleRows(Eigen::Index(filled), Eigen::Index(got)) = chunk;
+        filled += got;
+        cursorImage += got;
+        if (cursorImage >= s.count()) { // wrap to the next shard (and around the list)
+            cursorFile = (cursorFile + 1) % files.size();
+            cursorImage = 0;
+        }
+        if (got == 0) break;
+    }
+    if (filled < n) window->conservativeResize(Eigen::Index(filled), window->cols());
+    return window;
+}
+
+void ShardedDataset::prefetch()
+{
+    loading = global_pool().submit([this] {
+        std::shared_ptr<const MatrixXu8> w = loadWindow();
+        std::lock_guard<std::mutex> lock(mtx);
+        next = std::move(w);
+    });
+}
+
+void ShardedDataset::sample(int n, std::mt19937 &rng, MatrixXu8 &X)
+{
+    std::shared_ptr<const MatrixXu8> window;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        const size_t limit = shard_window_draws > 0 ? shard_window_draws : size_t(current->rows());
+        if (draws >= limit && next) { // never waits: without a ready window, keep drawing from this one
+            current = std::move(next);
+            draws = 0;
+            prefetch();
+        }
+        draws += size_t(n);
+        window = current;
+    }
+    std::uniform_int_distribution<int> U(0, int(window->rows()) - 1);
+    X.resize(n, window->cols());
+    for (int i = 0; i < n; ++i) X.row(i) = window->row(U(rng));
+}
+
+void ShardedDataset::read(size_t first, size_t n, MatrixXu8 &X) const
+{
+    first = std::min(first, size_);
+    n = std::min(n, size_ - first);
+    X.resize(Eigen::Index(n), shape_.dim());
+    MatrixXu8 chunk;
+    size_t filled = 0;
+    size_t file = size_t(std::upper_bound(starts.begin(), starts.end(), first) - starts.begin()) - 1;
+    while (filled < n && file < files.size()) {
+        ImageStream s;
+        if (!s.open(files[file], raw_shape) || !s.seek(first + filled - starts[file])) break;
+        const size_t got = s.next(chunk, n - filled);
+        X.middleRows(Eigen::Index(filled), Eigen::Index(got)) = chunk;
+        filled += got;
+        ++file;
+    }
+    if (filled < n) X.conservativeResize(Eigen::Index(filled), X.cols());
+}
+
+
+// ------------------------------------------------------------
+// Opening a spec
+// ------------------------------------------------------------
+static std::vector<std::string> sorted_files(const fs::path &dir, bool imagesOnly)
+{
+    std::vector<std::string> out;
+    for (const auto &entry : fs::directory_iterator(dir)) {
+        if (!entry.is_regular_file()) continue;
+        std::string ext = entry.path().extension().string();
+        std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return char(std::tolower(c)); });
+        if (!imagesOnly || ext == ".png" || ext == ".pgm" || ext == ".ppm") out.push_back(entry.path().string());
+    }
+    std::sort(out.begin(), out.end());
+    return out;
+}
+
+static std::unique_ptr<InMemoryDataset> open_image_dir(const fs::path &dir)
+{
+    const std::vector<std::string> paths = sorted_files(dir, true);
+    if (paths.empty()) {
+        std::cerr << "ERROR: no .png/.pgm/.ppm images in " << dir << "\n";
+        return nullptr;
+    }
+    std::vector<std::vector<uint8_t>> pixels(paths.size());
+    std::vector<ImageShape> shapes(paths.size());
+    std::vector<char> ok(paths.size(), 0);
+    global_pool().parallelFor(int(paths.size()), [&](int i) { ok[size_t(i)] = read_image(paths[size_t(i)], pixels[size_t(i)], shapes[size_t(i)]); });
+
+    for (size_t i = 0; i < paths.size(); ++i) { // every image read and alike before sizing anything from them
+        if (!ok[i]) return nullptr;
+        if (shapes[i] != shapes[0]) {
+            std::cerr << "ERROR: " << paths[i] << " is " << shapes[i].width << "x" << shapes[i].height << "x" << shapes[i].channels
+                      << ", the first image is " << shapes[0].width << "x" << shapes[0].height << "x" << shapes[0].channels << "\n";
+            return nullptr;
+        }
+    }
+    MatrixXu8 images(Eigen::Index(paths.size()), shapes[0].dim());
+    for (size_t i = 0; i < paths.size(); ++i)
+        images.row(Eigen::Index(i)) = Eigen::Map<const Eigen::Matrix<uint8_t, 1, Eigen::Dynamic>>(pixels[i].data(), shapes[0].dim());
+    return std::make_unique<InMemoryDataset>(std::move(images), shapes[0]);
+}
+
+static std::unique_ptr<InMemoryDataset> load_in_memory(const std::string &spec)
+{
+    if (fs::is_directory(spec)) return open_image_dir(spec);
+
+    ImageStream s;
+    if (!s.open(spec, raw_shape)) return nullptr;
+    MatrixXu8 images;
+    const size_t count = s.count(); // next() lowers count() on a short read
+    if (count == 0 || s.next(images, count) != count) {
+        std::cerr << "ERROR: no images read from " << spec << "\n";
+        return nullptr;
+    }
+    return std::make_unique<InMemoryDataset>(std::move(images), s.shape());
+}
+
+/**
+ * @brief FNV-1a over what the decoded images depend on: the absolute path, raw_shape, and the size
+ * @brief and mtime of the file or of every image in the directory. pathKey is the hash of the
+ * @brief path alone: the same for every version of the source.
+ */
+static bool source_fingerprint(const std::string &spec, uint64_t &fingerprint, uint64_t &pathKey)
+{
+    uint64_t h = 1469598103934665603ull;
+    auto mix = [&h](const void *data, size_t n) {
+        const unsigned char *c = static_cast<const unsigned char *>(data);
+        for (size_t i = 0; i < n; ++i) h = (h ^ c[i]) * 1099511628211ull;
+    };
+    std::error_code ec;
+    const std::string absolute = fs::absolute(spec, ec).lexically_normal().string();
+    mix(absolute.data(), absolute.size());
+    pathKey = h;
+    mix(&raw_shape, sizeof(raw_shape));
+    const std::vector<std::string> files = fs::is_directory(spec, ec) ? sorted_files(spec, true) : std::vector<std::string>{spec};
+    for (const std::string &file : files) {
+        const uint64_t size = uint64_t(fs::file_size(file, ec));
+        if (ec) return false;
+        const int64_t mtime = int64_t(fs::last_write_time(file, ec).time_since_epoch().count());
+        if (ec) return false;
+        mix(file.data(), file.size());
+        mix(&size, sizeof(size));
+        mix(&mtime, sizeof(mtime));
+    }
+    fingerprint = h;
+    return true;
+}
+
+/**
+ * @brief Deletes the caches of earlier versions of a source: files in dataset_cache named
+ * @brief prefix<fingerprint>.vdc other than keep. A run still mapping one keeps its pages.
+ */
+static void remove_stale_caches(const std::string &prefix, const std::string &keep)
+{
+    std::error_code ec;
+    for (const fs::directory_entry &entry : fs::directory_iterator(dataset_cache, ec)) {
+        const std::string name = entry.path().filename().string();
+        if (name == keep || name.rfind(prefix, 0) != 0 || entry.path().extension() != ".vdc") continue;
+        std::error_code removeError;
+        if (fs::remove(entry.path(), removeError)) std::cout << "Removed stale dataset cache " << entry.path().string() << "\n";
+    }
+}
+
+static std::unique_ptr<Dataset> open_cached(const std::string &spec)
+{
+    uint64_t fingerprint = 0, pathKey = 0;
+    if (!source_fingerprint(spec, fingerprint, pathKey)) return load_in_memory(spec); // reports what is missing
+    std::ostringstream prefix, name;
+    prefix << fs::path(spec).lexically_normal().filename().string() << "-" << std::hex << pathKey << "-";
+    name << prefix.str() << std::hex << fingerprint << ".vdc";
+    const std::string path = (fs::path(dataset_cache) / name.str()).string();
+
+    auto mapped = std::make_unique<MappedDataset>(path, fingerprint);
+    if (mapped->ok()) return mapped;
+
+    std::unique_ptr<InMemoryDataset> loaded = load_in_memory(spec);
+    if (!loaded) return nullptr;
+    std::error_code ec;
+    fs::create_directories(dataset_cache, ec);
+    if (!MappedDataset::write(path, *loaded, fingerprint)) return loaded;
+    std::cout << "Wrote dataset cache " << path << "\n";
+    remove_stale_caches(prefix.str(), name.str());
+    mapped = std::make_unique<MappedDataset>(path, fingerprint);
+    if (mapped->ok()) return mapped; // drop the private copy: this run shares the mapping too
+    return loaded;
+}
+
+std::unique_ptr<Dataset> open_dataset(const std::string &spec)
+{
+    if (spec.rfind("shards:", 0) == 0) {
+        const std::string list = spec.substr(7);
+        std::vector<std::string> files;
+        if (fs::is_directory(list)) {
+            files = sorted_files(list, false);
+        } else {
+            std::stringstream ss(list);
+            for (std::string item; std::getline(ss, item, ',');)
+                if (!item.empty()) files.push_back(item);
+        }
+        if (files.empty()) {
+            std::cerr << "ERROR: no shard files in " << list << "\n";
+            return nullptr;
+        }
+        auto sharded = std::make_unique<ShardedDataset>(std::move(files));
+        if (!sharded->ok()) return nullptr;
+        return sharded;
+    }
+    if (!dataset_cache.empty()) return open_cached(spec);
+    return load_in_memory(spec);
+}
@@ -0,0 +1,128 @@
+#ifndef DATASET_H
+#define DATASET_H
+
+#include "image_io.h"
+#include "network.h"
+#include <future>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <vector>
+
+// ====== SETTINGS ======
+extern ImageShape raw_shape;     // shape of headerless raw files and shards (IDX files carry their own)
+extern size_t shard_window;       // images of a sharded dataset resident at once
+extern size_t shard_window_draws; // images sampled from a window before the prefetched next one replaces it, 0 = window size
+extern std::string dataset_cache; // directory of decoded datasets that concurrent runs map and share, "" = off
+
+/**
+ * @brief A set of same-shape u8 images, one HWC row of shape().dim() pixels per image.
+ * @brief sample() and read() may be called from several threads at once.
+ */
+class Dataset
+{
+public:
+    virtual ~Dataset() = default;
+    const ImageShape &shape() const { return shape_; }
+    size_t size() const { return size_; }
+
+    virtual void sample(int n, std::mt19937 &rng, MatrixXu8 &X) = 0;           // n random images
+    virtual void read(size_t first, size_t n, MatrixXu8 &X) const = 0;          // images [first, first + n), in order
+
+protected:
+    ImageShape shape_{0, 0, 0};
+    size_t size_ = 0;
+};
+
+/**
+ * @brief The whole dataset in RAM: one IDX or raw file, or a directory of PNG/PGM/PPM images.
+ */
+class InMemoryDataset : public Dataset
+{
+public:
+    explicit InMemoryDataset(MatrixXu8 images, const ImageShape &shape);
+    void sample(int n, std::mt19937 &rng, MatrixXu8 &X) override;
+    void read(size_t first, size_t n, MatrixXu8 &X) const override;
+    const MatrixXu8 &images() const { return data; }
+
+private:
+    MatrixXu8 data;
+};
+
+/**
+ * @brief A dataset cache file (see open_dataset()) mapped read-only: the pixels are the page
+ * @brief cache's, so every process mapping the same file shares one copy, and opening one costs
+ * @brief a stat and an mmap instead of a parse. Batches are identical to the InMemoryDataset it
+ * @brief was written from, for the same RNG.
+ * @brief File: a header, then the images as row-major u8 rows from the first page boundary.
+ * @brief Native byte order: a cache is local to the machine that wrote it.
+ */
+class MappedDataset : public Dataset
+{
+public:
+    MappedDataset(const std::string &path, uint64_t fingerprint); // fingerprint of the source it must come from
+    ~MappedDataset() override;
+    MappedDataset(const MappedDataset &) = delete;
+    MappedDataset &operator=(const MappedDataset &) = delete;
+    bool ok() const { return base != nullptr; }
+
+    void sample(int n, std::mt19937 &rng, MatrixXu8 &X) override;
+    void read(size_t first, size_t n, MatrixXu8 &X) const override;
+    Eigen::Map<const MatrixXu8> images() const;
+
+    static bool write(const std::string &path, const InMemoryDataset &source, uint64_t fingerprint);
+
+private:
+    void *base = nullptr;
+    size_t bytes = 0;
+    const uint8_t *pixels = nullptr;
+};
+
+/**
+ * @brief Datasets larger than RAM: a list of IDX or raw shard files, streamed through a window of
+ * @brief shard_window images. sample() draws from the resident window; once shard_window_draws images
+ * @brief have been drawn, the next window (read in the background on the pool, wrapping around the
+ * @brief shard list) replaces it. If it is not ready yet, sampling carries on from the current one,
+ * @brief so training never waits on the disk. Sampling is uniform within a window, not over the
+ * @brief whole set; shards should be written in shuffled order.
+ */
+class ShardedDataset : public Dataset
+{
+public:
+    explicit ShardedDataset(std::vector<std::string> files);
+    ~ShardedDataset() override;
+    bool ok() const { return current != nullptr; }
+
+    void sample(int n, std::mt19937 &rng, MatrixXu8 &X) override;
+    void read(size_t first, size_t n, MatrixXu8 &X) const override;
+
+private:
+    std::shared_ptr<const MatrixXu8> loadWindow(); // next shard_window images after the cursor
+    void prefetch();
+
+    std::vector<std::string> files;
+    std::vector<size_t> starts; // index of each file's first image
+    size_t cursorFile = 0, cursorImage = 0; // touched only by loadWindow(), one call at a time
+
+    std::mutex mtx;
+    std::shared_ptr<const MatrixXu8> current, next;
+    size_t draws = 0;
+    std::future<void> loading;
+};
+
+/**
+ * @brief Open a dataset from a spec:
+ * @brief   FILE          : IDX (3 or 4 dims) or raw_shape images, loaded into memory
+ * @brief   DIR           : every .png/.pgm/.ppm in DIR, sorted by name, loaded into memory
+ * @brief   shards:DIR    : every file in DIR, sorted by name, as shards
+ * @brief   shards:A,B,.. : the listed files as shards
+ * @brief With dataset_cache set, FILE and DIR specs go through a cache file in that directory, keyed
+ * @brief by the source's path, sizes, mtimes and raw_shape: the first run decodes and writes it,
+ * @brief every run (that one included) maps it, and the caches of older versions of the same
+ * @brief source are deleted. Shards stream and are never cached.
+ * @return nullptr (after printing why) on failure.
+ */
+std::unique_ptr<Dataset> open_dataset(const std::string &spec);
+
+#endif // DATASET_H
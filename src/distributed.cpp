@@ -0,0 +1,140 @@
+#include "distributed.h"
+#include "profiler.h"
+#include "shape.h"
+#include <algorithm>
+#include <chrono>
+
+// ====== SETTINGS ======
+bool overlap_allreduce = true;
+
+typedef std::chrono::steady_clock Clock;
+
+static GradBucket layer_bucket(int layer, Gradients &g, float *loss)
+{
+    switch (layer) {
+    case 3: return {{g.Gw3.data(), size_t(g.Gw3.size())}, {g.Gb3.data(), size_t(g.Gb3.size())}};
+    case 2: return {{g.Gw2.data(), size_t(g.Gw2.size())}, {g.Gb2.data(), size_t(g.Gb2.size())}};
+    default: return {{g.Gw1.data(), size_t(g.Gw1.size())}, {g.Gb1.data(), size_t(g.Gb1.size())}, {loss, 1}};
+    }
+}
+
+static GradBucket weight_bucket(int layer, Weights &w)
+{
+    switch (layer) {
+    case 3: return {{w.W3.data(), size_t(w.W3.size())}, {w.b3.data(), size_t(w.b3.size())}};
+    case 2: return {{w.W2.data(), size_t(w.W2.size())}, {w.b2.data(), size_t(w.b2.size())}};
+    default: return {{w.W1.data(), size_t(w.W1.size())}, {w.b1.data(), size_t(w.b1.size())}};
+    }
+}
+
+size_t largest_bucket(const Weights &w)
+{
+    return size_t(std::max({w.W1.size() + w.b1.size() + 1, w.W2.size() + w.b2.size(), w.W3.size() + w.b3.size()}));
+}
+
+DistributedTrainer::DistributedTrainer(Transport &transport, uint32_t seed)
+    : transport(transport), rng(seed + uint32_t(transport.rank()))
+{
+    if (overlap_allreduce && transport.size() > 1) comm = std::thread([this] { commLoop(); });
+}
+
+DistributedTrainer::~DistributedTrainer()
+{
+    if (!comm.joinable()) return;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        stop = true;
+    }
+    cv.notify_all();
+    comm.join();
+}
+
+/**
+ * @brief Non-zero ranks zero their weights and everything is summed: one all-reduce is the
+ * @brief broadcast, with no extra code path in the transport.
+ */
+bool DistributedTrainer::syncWeights(Weights &weights)
+{
+    for (int layer = 3; layer >= 1; --layer) {
+        GradBucket bucket = weight_bucket(layer, weights);
+        if (transport.rank() != 0)
+            for (GradSpan &s : bucket) std::fill(s.data, s.data + s.size, 0.0f);
+        if (!transport.allreduce(bucket)) return false;
+    }
+    return true;
+}
+
+bool DistributedTrainer::reduceLayer(int layer)
+{
+    PROFILE_SCOPE("allreduce");
+    const auto t0 = Clock::now();
+    const bool done = transport.allreduce(layer_bucket(layer, gradients, &lossSum));
+    reduceSeconds += std::chrono::duration<double>(Clock::now() - t0).count();
+    return done;
+}
+
+void DistributedTrainer::commLoop()
+{
+    std::unique_lock<std::mutex> lock(mtx);
+    while (true) {
+        cv.wait(lock, [this] { return stop || !pending.empty(); });
+        if (stop) return;
+        const int layer = pending.front();
+        pending.pop_front();
+        const bool good = ok;
+        lock.unlock();
+        const bool done = good && reduceLayer(layer); // after a failure, only count the layer off
+        lock.lock();
+        ok = ok && done;
+        ++reduced;
+        cv.notify_all();
+    }
+}
+
+/**
+ * @brief Sample, forward and backward this rank's batch, all-reduce the gradients, and update.
+ * @param weights REFERENCE : identical on every rank before and after the step.
+ * @param loss REFERENCE : mean loss over the ranks' batches.
+ */
+bool DistributedTrainer::step(Weights &weights, double &loss)
+{
+    const int W = transport.size();
+    {
+        PROFILE_SCOPE("data");
+        X = make_batch_u8(B, rng, true, &Xs);
+    }
+    const SparseBatch *sparse = useSparseInput(Xs) ? &Xs : nullptr;
+    forwardPass(forward, weights, X, sparse);
+    lossSum = float(forward.loss);
+
+    if (comm.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            reduced = 0;
+        }
+        backPass(gradients, forward, weights, X, sparse, [this](int layer) {
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                pending.push_back(layer);
+            }
+            cv.notify_all();
+        });
+        const auto t0 = Clock::now();
+        std::unique_lock<std::mutex> lock(mtx);
+        cv.wait(lock, [this] { return reduced == 3; });
+        waitSeconds += std::chrono::duration<double>(Clock::now() - t0).count();
+        if (!ok) return false;
+    } else {
+        backPass(gradients, forward, weights, X, sparse);
+        const auto t0 = Clock::now();
+        for (int layer = 3; layer >= 1; --layer)
+            if (!reduceLayer(layer)) return false;
+        waitSeconds += std::chrono::duration<double>(Clock::now() - t0).count();
+    }
+
+    // backPass averages over this rank's B samples; average over the ranks too.
+    if (W > 1) scaleGradients(gradients, 1.0f / float(W));
+    backProp(weights, gradients);
+    loss = double(lossSum) / W;
+    return true;
+}
@@ -0,0 +1,67 @@
+#ifndef DISTRIBUTED_H
+#define DISTRIBUTED_H
+
+#include "allreduce.h"
+#include "network.h"
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <random>
+#include <thread>
+
+// ====== SETTINGS ======
+extern bool overlap_allreduce; // ship each layer's gradients while the earlier layers are still in backward
+
+size_t largest_bucket(const Weights &weights); // floats in the biggest per-layer bucket (+1 for the loss)
+
+/**
+ * @brief Data-parallel training, one process (rank) per replica. Every rank holds the full
+ * @brief Weights, draws its own B samples (stream seed + rank, like micro-batch k of Trainer),
+ * @brief and the gradients are summed across ranks through a Transport, then averaged and
+ * @brief applied by every rank: the replicas stay bit-identical without ever sending weights.
+ * @brief One step with W ranks is the same update as Trainer with accum_steps = W, up to the
+ * @brief order of the float sums.
+ * @brief Gradients go out in three buckets, one per layer ({Gw3, Gb3}, {Gw2, Gb2}, {Gw1, Gb1, loss}),
+ * @brief in the order backPass() finishes them. With overlap_allreduce a communication thread
+ * @brief reduces layer 3 while layers 2 and 1 are computed; it is a dedicated thread rather
+ * @brief than a pool task because it spends its time blocked on the peers.
+ */
+class DistributedTrainer
+{
+public:
+    DistributedTrainer(Transport &transport, uint32_t seed);
+    ~DistributedTrainer();
+
+    DistributedTrainer(const DistributedTrainer &) = delete;
+    DistributedTrainer &operator=(const DistributedTrainer &) = delete;
+
+    bool syncWeights(Weights &weights); // every rank takes rank 0's weights
+    bool step(Weights &weights, double &loss); // loss: mean over all ranks; false if the transport failed
+    double commWaitSeconds() const { return waitSeconds; } // backward finished, gradients not yet reduced
+    double commSeconds() const { return reduceSeconds; }   // time inside allreduce()
+
+private:
+    bool reduceLayer(int layer);
+    void commLoop();
+
+    Transport &transport;
+    std::mt19937 rng;
+    MatrixXu8 X;
+    SparseBatch Xs;
+    ForwardOutput forward;
+    Gradients gradients;
+    float lossSum = 0.0f; // reduced with layer 1
+
+    std::thread comm; // only with overlap_allreduce
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::deque<int> pending; // layers waiting for the communication thread
+    int reduced = 0;         // layers reduced this step
+    bool ok = true;
+    bool stop = false;
+
+    double waitSeconds = 0.0;
+    double reduceSeconds = 0.0;
+};
+
+#endif // DISTRIBUTED_H
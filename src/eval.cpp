@@ -0,0 +1,82 @@
+#include "eval.h"
+#include "profiler.h"
+#include "shape.h"
+#include <chrono>
+#include <vector>
+
+// ====== SETTINGS ======
+int eval_every = 1000;
+int eval_batch = 500;
+
+/**
+ * @brief Mean BCE of the weights over a whole split, forward only.
+ * @brief The split is cut into eval_batch-row blocks run in parallel; the block losses are
+ * @brief summed in block order, so the result does not depend on the number of threads.
+ * @param weights const : Read by every block; must not change during the pass.
+ */
+EvalResult evaluate(const Weights &weights, bool use_train, ThreadPool &pool)
+{
+    PROFILE_SCOPE("eval");
+    const auto t0 = std::chrono::steady_clock::now();
+    const Dataset &images = dataset(use_train);
+    const long rows = long(images.size());
+    const long grain = std::max(1, eval_batch);
+
+    std::vector<double> blockLoss((rows + grain - 1) / grain, 0.0);
+    pool.parallelForRows(rows, grain, [&](long begin, long end) {
+        MatrixXu8 X;
+        images.read(size_t(begin), size_t(end - begin), X);
+        SparseBatch Xs = X.cast<float>().sparseView() / 255.0f;
+        ForwardOutput forward(false); // only the loss is needed: score the output tile by tile
+        forwardPass(forward, weights, X, useSparseInput(Xs) ? &Xs : nullptr);
+        blockLoss[size_t(begin / grain)] = forward.loss * double(end - begin); // loss is a mean over the block
+    });
+
+    EvalResult result;
+    result.images = size_t(rows);
+    for (double l : blockLoss) result.bce += l;
+    result.bce /= double(std::max(rows, 1L));
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    return result;
+}
+
+
+Evaluator::Evaluator(ThreadPool &pool) : pool(pool) {}
+
+Evaluator::~Evaluator()
+{
+    EvalResult ignored;
+    finish(ignored); // the task may still be running
+}
+
+/**
+ * @brief Queue a test-set pass on the pool; the pass holds the pin until it is done.
+ * @return false if there is nothing published yet or the previous pass has not finished.
+ */
+bool Evaluator::start(WeightPublisher::Reader weights)
+{
+    if (!weights) return false;
+    if (running.valid() && running.wait_for(std::chrono::seconds(0)) != std::future_status::ready) return false;
+    if (running.valid()) running.wait(); // finished but never polled: drop it
+
+    running = pool.submit([this, pinned = std::move(weights)] {
+        EvalResult r = evaluate(pinned.weights(), false, pool);
+        r.iteration = pinned.iteration();
+        return r;
+    });
+    return true;
+}
+
+bool Evaluator::poll(EvalResult &result)
+{
+    if (!running.valid() || running.wait_for(std::chrono::seconds(0)) != std::future_status::ready) return false;
+    result = running.get();
+    return true;
+}
+
+bool Evaluator::finish(EvalResult &result)
+{
+    if (!running.valid()) return false;
+    result = pool.wait(running);
+    return true;
+}
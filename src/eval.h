@@ -0,0 +1,43 @@
+#ifndef EVAL_H
+#define EVAL_H
+
+#include "network.h"
+#include "thread_pool.h"
+#include "weight_store.h"
+#include <future>
+
+// ====== SETTINGS ======
+extern int eval_every; // iterations between full test-set passes, 0 = off
+extern int eval_batch; // images per inference batch
+
+struct EvalResult
+{
+    size_t iteration = 0;
+    size_t images = 0;
+    double bce = 0.0;     // mean BCE per pixel, same scale as the training loss
+    double seconds = 0.0; // wall time of the pass
+};
+
+EvalResult evaluate(const Weights &weights, bool use_train = false, ThreadPool &pool = global_pool());
+
+/**
+ * @brief Runs evaluate() on the test set in the background, on a pinned published version of
+ * @brief the weights, so the trainer keeps updating its own. One pass at a time: start() returns
+ * @brief false while the previous pass is still running.
+ */
+class Evaluator
+{
+public:
+    explicit Evaluator(ThreadPool &pool = global_pool());
+    ~Evaluator();
+
+    bool start(WeightPublisher::Reader weights); // reports weights.iteration()
+    bool poll(EvalResult &result); // true once per finished pass, never blocks
+    bool finish(EvalResult &result); // waits for the pass in flight, false if there was none
+
+private:
+    ThreadPool &pool;
+    std::future<EvalResult> running;
+};
+
+#endif // EVAL_H
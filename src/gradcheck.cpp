@@ -0,0 +1,153 @@
+#include "gradcheck.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <random>
+
+// ------------------------------------------------------------
+// Flat views of the six parameter tensors (all Eigen storage is contiguous)
+// ------------------------------------------------------------
+struct TensorView
+{
+    const char *name;
+    float *data;
+    int rows, cols;
+    bool rowMajor;
+    float &at(int r, int c) const { return rowMajor ? data[size_t(r) * cols + c] : data[size_t(c) * rows + r]; }
+};
+
+static std::vector<TensorView> views(Weights &w)
+{
+    return {{"W1", w.W1.data(), int(w.W1.rows()), int(w.W1.cols()), true}, {"b1", w.b1.data(), 1, int(w.b1.cols()), true},
+            {"W2", w.W2.data(), int(w.W2.rows()), int(w.W2.cols()), false}, {"b2", w.b2.data(), 1, int(w.b2.cols()), true},
+            {"W3", w.W3.data(), int(w.W3.rows()), int(w.W3.cols()), false}, {"b3", w.b3.data(), 1, int(w.b3.cols()), true}};
+}
+
+static std::vector<TensorView> views(Gradients &g)
+{
+    return {{"W1", g.Gw1.data(), int(g.Gw1.rows()), int(g.Gw1.cols()), true}, {"b1", g.Gb1.data(), 1, int(g.Gb1.cols()), true},
+            {"W2", g.Gw2.data(), int(g.Gw2.rows()), int(g.Gw2.cols()), false}, {"b2", g.Gb2.data(), 1, int(g.Gb2.cols()), true},
+            {"W3", g.Gw3.data(), int(g.Gw3.rows()), int(g.Gw3.cols()), false}, {"b3", g.Gb3.data(), 1, int(g.Gb3.cols()), true}};
+}
+
+/**
+ * @brief Same BCE as forwardPass() but accumulated in double: a float mean over B*D entries
+ * @brief is too coarse for the tiny loss differences a single-weight perturbation makes.
+ */
+static double loss_double(const ForwardOutput &forward, const MatrixXfRow &X)
+{
+    const Eigen::ArrayXXd s = forward.sigmoid.array().cast<double>();
+    const Eigen::ArrayXXd x = X.array().cast<double>();
+    return -(x * s.log() + (1.0 - x) * (1.0 - s).log()).mean();
+}
+
+struct Probe
+{
+    int tensor, row, col;
+    double numeric = 0.0;
+};
+
+
+// ------------------------------------------------------------
+// Public: check sampled coordinates of every tensor in parallel
+// ------------------------------------------------------------
+std::vector<GradCheckResult> gradCheck(const Weights &weights, const MatrixXfRow &X, const GradCheckOptions &opts)
+{
+    SparseBatch csr;
+    const SparseBatch *Xs = nullptr;
+    if (opts.sparseInput) {
+        csr = X.sparseView();
+        Xs = &csr;
+    }
+
+    // Analytic gradients once, on the unperturbed weights.
+    Weights base = weights;
+    ForwardOutput forward;
+    Gradients gradients;
+    forwardPass(forward, base, X, Xs);
+    backPass(gradients, forward, base, X, Xs);
+
+    // Draw every probe up front so the split across threads cannot change the sample.
+    std::mt19937 rng(opts.seed);
+    std::vector<Probe> probes;
+    const std::vector<TensorView> wv = views(base);
+    for (int t = 0; t < int(wv.size()); ++t) {
+        std::uniform_int_distribution<int> R(0, wv[t].rows - 1), C(0, wv[t].cols - 1);
+        for (int k = 0; k < opts.samplesPerTensor; ++k) probes.push_back({t, R(rng), C(rng)});
+    }
+
+    int threads = opts.threads > 0 ? opts.threads : global_pool().size() + 1;
+    threads = std::max(1, std::min<int>(threads, int(probes.size())));
+
+    auto work = [&](size_t begin, size_t end) {
+        Weights w = weights; // private copy, perturbed one coordinate at a time
+        ForwardOutput fw;
+        const std::vector<TensorView> v = views(w);
+        for (size_t i = begin; i < end; ++i) {
+            Probe &p = probes[i];
+            float &param = v[p.tensor].at(p.row, p.col);
+            const float orig = param;
+            const float h = float(opts.eps * std::max(1.0, std::fabs(double(orig))));
+
+            param = orig + h;
+            const float hPlus = param - orig; // the step actually representable in float
+            forwardPass(fw, w, X, Xs);
+            const double lPlus = loss_double(fw, X);
+
+            param = orig - h;
+            const float hMinus = orig - param;
+            forwardPass(fw, w, X, Xs);
+            const double lMinus = loss_double(fw, X);
+
+            param = orig;
+            p.numeric = (lPlus - lMinus) / (double(hPlus) + double(hMinus));
+        }
+    };
+
+    const size_t per = (probes.size() + threads - 1) / threads;
+    global_pool().parallelForRows(long(probes.size()), long(per), [&](long begin, long end) { work(size_t(begin), size_t(end)); });
+
+    // Relative error with a per-tensor floor, so coordinates whose gradient is ~0
+    // are judged against the tensor's gradient scale instead of dividing by noise.
+    std::vector<GradCheckResult> results;
+    const std::vector<TensorView> gv = views(gradients);
+    for (int t = 0; t < int(wv.size()); ++t) {
+        GradCheckResult r;
+        r.tensor = wv[t].name;
+        const Eigen::Map<const Eigen::ArrayXf> g(gv[t].data, Eigen::Index(gv[t].rows) * gv[t].cols);
+        const double floor = std::max(1e-2 * double(g.abs().maxCoeff()), 1e-12);
+        double sum = 0.0;
+        for (const Probe &p : probes) {
+            if (p.tensor != t) continue;
+            const double analytic = gv[t].at(p.row, p.col);
+            const double rel = std::fabs(p.numeric - analytic) /
+                               std::max({std::fabs(p.numeric), std::fabs(analytic), floor});
+            ++r.checked;
+            sum += rel;
+            if (rel > opts.tolerance) ++r.failures;
+            if (rel >= r.maxRelErr) {
+                r.maxRelErr = rel;
+                r.worstRow = p.row;
+                r.worstCol = p.col;
+                r.worstNumeric = p.numeric;
+                r.worstAnalytic = analytic;
+            }
+        }
+        r.meanRelErr = r.checked ? sum / r.checked : 0.0;
+        results.push_back(r);
+    }
+    return results;
+}
+
+void printGradCheck(const std::vector<GradCheckResult> &results, std::ostream &out)
+{
+    out << std::left << std::setw(6) << "tensor" << std::right << std::setw(9) << "checked" << std::setw(10) << "failed"
+        << std::setw(14) << "mean rel" << std::setw(14) << "max rel" << "   worst (row,col) numeric / analytic\n";
+    for (const GradCheckResult &r : results) {
+        out << std::left << std::setw(6) << r.tensor << std::right << std::setw(9) << r.checked << std::setw(10)
+            << r.failures << std::scientific << std::setprecision(3) << std::setw(14) << r.meanRelErr << std::setw(14)
+            << r.maxRelErr << "   (" << r.worstRow << "," << r.worstCol << ") " << r.worstNumeric << " / "
+            << r.worstAnalytic << std::defaultfloat << "\n";
+    }
+}
@@ -0,0 +1,37 @@
+#ifndef GRADCHECK_H
+#define GRADCHECK_H
+
+#include "network.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Numerical check of backPass() against central differences of forwardPass().
+// Coordinates are drawn from a seeded RNG before any work is split, and every thread
+// writes into its own slots, so the report is identical for any thread count.
+
+struct GradCheckOptions
+{
+    int samplesPerTensor = 256; // coordinates checked in each of W1 b1 W2 b2 W3 b3
+    double eps = 3e-2;          // step is eps * max(1, |w|); float forward passes need a large step
+    double tolerance = 5e-2;    // relative error above which a coordinate counts as failed
+    int threads = 0;            // probe chunks on global_pool(), 0 = one per pool thread
+    bool sparseInput = false;   // run both passes through the CSR first-layer kernels
+    uint32_t seed = 1234u;
+};
+
+struct GradCheckResult
+{
+    std::string tensor;
+    int checked = 0;
+    int failures = 0;
+    double maxRelErr = 0.0;
+    double meanRelErr = 0.0;
+    int worstRow = 0, worstCol = 0;
+    double worstNumeric = 0.0, worstAnalytic = 0.0;
+};
+
+std::vector<GradCheckResult> gradCheck(const Weights &weights, const MatrixXfRow &X, const GradCheckOptions &opts);
+void printGradCheck(const std::vector<GradCheckResult> &results, std::ostream &out);
+
+#endif // GRADCHECK_H
@@ -0,0 +1,324 @@
+#include "image_io.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <zlib.h>
+
+#include "/Users/daboi/Documents/Projects/VAE/Intelligent_Data_Compression_Framework/third_party/stb/stb_image_write.h"
+
+
+// ------------------------------------------------------------
+// Tile packer: float [0,1] -> u8, one contiguous tile row at a time
+// ------------------------------------------------------------
+void pack_tiles_u8(const MatrixXfRow &batch,
+                   const ImageShape &tile,
+                   int gridCols,
+                   int gridRows,
+                   std::vector<uint8_t> &img)
+{
+    const int tileW = tile.width * tile.channels; // bytes per tile row
+    const int tileH = tile.height;
+    const int outW = gridCols * tileW;
+    const int outH = gridRows * tileH;
+    img.assign(size_t(outW) * outH, 0);
+
+    const Eigen::Index n = std::min<Eigen::Index>(batch.rows(), Eigen::Index(gridCols) * gridRows);
+    for (Eigen::Index b = 0; b < n; ++b) {
+        const int gx = int(b % gridCols);
+        const int gy = int(b / gridCols);
+        for (int y = 0; y < tileH; ++y) {
+            uint8_t *dst = img.data() + size_t(gy * tileH + y) * outW + size_t(gx) * tileW;
+            Eigen::Map<Eigen::Array<uint8_t, 1, Eigen::Dynamic>>(dst, tileW) =
+                (batch.row(b).segment(y * tileW, tileW).array().max(0.0f).min(1.0f) * 255.0f + 0.5f)
+                    .cast<uint8_t>(); // +0.5 then truncate == round for v >= 0
+        }
+    }
+}
+
+
+// ------------------------------------------------------------
+// PNG framing (signature + length/type/data/crc chunks)
+// ------------------------------------------------------------
+static void put_u32_be(std::vector<uint8_t> &out, uint32_t v)
+{
+    out.push_back(uint8_t(v >> 24));
+    out.push_back(uint8_t(v >> 16));
+    out.push_back(uint8_t(v >> 8));
+    out.push_back(uint8_t(v));
+}
+
+static void put_chunk(std::vector<uint8_t> &out, const char type[4], const uint8_t *data, size_t len)
+{
+    put_u32_be(out, uint32_t(len));
+    const size_t start = out.size();
+    out.insert(out.end(), type, type + 4);
+    if (len > 0) out.insert(out.end(), data, data + len);
+    uint32_t crc = crc32(0L, out.data() + start, uInt(4 + len));
+    put_u32_be(out, crc);
+}
+
+
+// ------------------------------------------------------------
+// Deflate the filtered scanlines as independent raw-deflate chunks.
+// Every chunk but the last ends on a byte-aligned sync flush, so the
+// pieces concatenate into one valid zlib stream (same trick as pigz).
+// ------------------------------------------------------------
+static bool deflate_chunk(const uint8_t *src, size_t len, int level, bool last, std::vector<uint8_t> &out)
+{
+    z_stream zs;
+    std::memset(&zs, 0, sizeof(zs));
+    if (deflateInit2(&zs, level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK) return false;
+
+    out.resize(deflateBound(&zs, uLong(len)) + 16);
+    zs.next_in = const_cast<Bytef *>(src);
+    zs.avail_in = uInt(len);
+    zs.next_out = out.data();
+    zs.avail_out = uInt(out.size());
+
+    int rc = deflate(&zs, last ? Z_FINISH : Z_SYNC_FLUSH);
+    bool ok = last ? (rc == Z_STREAM_END) : (rc == Z_OK && zs.avail_in == 0);
+    out.resize(zs.total_out);
+    deflateEnd(&zs);
+    return ok;
+}
+
+static bool zlib_parallel(const std::vector<uint8_t> &raw, size_t rowBytes, int level, int threads,
+                          std::vector<uint8_t> &out)
+{
+    const size_t nRows = raw.size() / rowBytes;
+    const size_t wanted = std::max<size_t>(1, std::min<size_t>(size_t(threads), nRows));
+    const size_t rowsPer = std::max<size_t>(1, (nRows + wanted - 1) / wanted);
+    const size_t nChunks = std::max<size_t>(1, (nRows + rowsPer - 1) / rowsPer); // rounding up rowsPer can leave fewer, never empty ones
+
+    std::vector<std::vector<uint8_t>> pieces(nChunks);
+    std::vector<uLong> adlers(nChunks);
+    std::vector<size_t> lens(nChunks);
+    std::vector<char> ok(nChunks, 0);
+
+    auto work = [&](size_t c) {
+        const size_t r0 = c * rowsPer;
+        const size_t r1 = std::min(nRows, r0 + rowsPer);
+        const uint8_t *src = raw.data() + r0 * rowBytes;
+        lens[c] = (r1 - r0) * rowBytes;
+        adlers[c] = adler32(adler32(0L, Z_NULL, 0), src, uInt(lens[c]));
+        ok[c] = deflate_chunk(src, lens[c], level, c + 1 == nChunks, pieces[c]);
+    };
+
+    global_pool().parallelFor(int(nChunks), [&](int c) { work(size_t(c)); });
+
+    uLong adler = adlers[0];
+    for (size_t c = 1; c < nChunks; ++c) adler = adler32_combine(adler, adlers[c], z_off_t(lens[c]));
+
+    out.clear();
+    out.push_back(0x78); // CMF: deflate, 32K window
+    out.push_back(0x01); // FLG: no dict, check bits for 0x7801
+    for (size_t c = 0; c < nChunks; ++c) {
+        if (!ok[c]) return false;
+        out.insert(out.end(), pieces[c].begin(), pieces[c].end());
+    }
+    put_u32_be(out, uint32_t(adler));
+    return true;
+}
+
+static const uint8_t kColorType[5] = {0, 0 /*gray*/, 4 /*gray+alpha*/, 2 /*RGB*/, 6 /*RGBA*/};
+
+static bool write_png_zlib(const std::string &outPath, const uint8_t *img, int width, int height, int channels,
+                           int level, int threads)
+{
+    // Filter type 0 (None) on every scanline: cheap, and tiles are mostly flat anyway.
+    const size_t lineBytes = size_t(width) * channels;
+    const size_t rowBytes = lineBytes + 1;
+    std::vector<uint8_t> raw(rowBytes * height);
+    for (int y = 0; y < height; ++y) {
+        raw[y * rowBytes] = 0;
+        std::memcpy(&raw[y * rowBytes + 1], img + size_t(y) * lineBytes, lineBytes);
+    }
+
+    std::vector<uint8_t> idat;
+    if (!zlib_parallel(raw, rowBytes, level, threads, idat)) return false;
+
+    static const uint8_t signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+    std::vector<uint8_t> png(signature, signature + 8);
+    std::vector<uint8_t> ihdr;
+    put_u32_be(ihdr, uint32_t(width));
+    put_u32_be(ihdr, uint32_t(height));
+    ihdr.insert(ihdr.end(), {8 /*bit depth*/, kColorType[channels], 0, 0, 0});
+    put_chunk(png, "IHDR", ihdr.data(), ihdr.size());
+    put_chunk(png, "IDAT", idat.data(), idat.size());
+    put_chunk(png, "IEND", nullptr, 0);
+
+    std::ofstream f(outPath, std::ios::binary);
+    f.write((const char *)png.data(), std::streamsize(png.size()));
+    return bool(f);
+}
+
+static bool write_pnm(const std::string &outPath, const uint8_t *img, int width, int height, int channels)
+{
+    if (channels != 1 && channels != 3) {
+        std::cerr << "ERROR: PGM/PPM need 1 or 3 channels, not " << channels << ": " << outPath << "\n";
+        return false;
+    }
+    std::ofstream f(outPath, std::ios::binary);
+    f << (channels == 1 ? "P5\n" : "P6\n") << width << " " << height << "\n255\n";
+    f.write((const char *)img, std::streamsize(size_t(width) * height * channels));
+    return bool(f);
+}
+
+
+// ------------------------------------------------------------
+// Public: write an 8-bit image (1-4 interleaved channels) in the requested format
+// ------------------------------------------------------------
+bool write_image(const std::string &outPath,
+                 const uint8_t *img,
+                 int width,
+                 int height,
+                 int channels,
+                 const ImageWriteOptions &opts)
+{
+    if (channels < 1 || channels > 4) return false;
+    switch (opts.format) {
+    case ImageFormat::Pgm:
+        return write_pnm(outPath, img, width, height, channels);
+    case ImageFormat::PngStored:
+        return write_png_zlib(outPath, img, width, height, channels, 0, 1);
+    case ImageFormat::PngFast:
+        return write_png_zlib(outPath, img, width, height, channels, 1, 1);
+    case ImageFormat::PngParallel: {
+        int threads = opts.threads > 0 ? opts.threads : global_pool().size() + 1;
+        return write_png_zlib(outPath, img, width, height, channels, opts.level, std::max(threads, 1));
+    }
+    case ImageFormat::PngStb:
+        return stbi_write_png(outPath.c_str(), width, height, channels, img, width * channels) != 0;
+    }
+    return false;
+}
+
+
+// ------------------------------------------------------------
+// Readers: PNG (zlib inflate + scanline unfiltering) and binary PNM
+// ------------------------------------------------------------
+static uint32_t get_u32_be(const uint8_t *p)
+{
+    return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+}
+
+// Headers claiming more are corrupt files, not images: rejected before anything is allocated.
+const size_t kMaxImageBytes = size_t(1) << 28; // 256 MB; keeps dim() well inside int
+
+static bool valid_shape(uint64_t width, uint64_t height, int channels)
+{
+    return width > 0 && height > 0 && width <= kMaxImageBytes && height <= kMaxImageBytes && // no overflow below
+           width * height <= kMaxImageBytes / uint64_t(channels);
+}
+
+static uint8_t paeth(int a, int b, int c)
+{
+    const int p = a + b - c;
+    const int pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+    return uint8_t(pa <= pb && pa <= pc ? a : (pb <= pc ? b : c));
+}
+
+static bool read_png(const std::vector<uint8_t> &file, std::vector<uint8_t> &pixels, ImageShape &shape)
+{
+    static const uint8_t signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+    if (file.size() < 8 || std::memcmp(file.data(), signature, 8) != 0) return false;
+
+    int channels = 0;
+    uint32_t width = 0, height = 0;
+    std::vector<uint8_t> idat;
+    for (size_t pos = 8; pos + 12 <= file.size();) {
+        const uint32_t len = get_u32_be(&file[pos]);
+        const uint8_t *type = &file[pos + 4];
+        const uint8_t *data = &file[pos + 8];
+        if (pos + 12 + len > file.size()) return false;
+        if (!std::memcmp(type, "IHDR", 4)) {
+            if (len != 13) return false;
+            width = get_u32_be(data);
+            height = get_u32_be(data + 4);
+            const uint8_t depth = data[8], color = data[9], interlace = data[12];
+            for (int c = 1; c <= 4; ++c)
+                if (kColorType[c] == color) channels = c;
+            if (depth != 8 || interlace != 0 || color == 3 || channels == 0) return false; // 8-bit, no palette, no Adam7
+            if (!valid_shape(width, height, channels)) return false;
+        } else if (!std::memcmp(type, "IDAT", 4)) {
+            idat.insert(idat.end(), data, data + len);
+        } else if (!std::memcmp(type, "IEND", 4)) {
+            break;
+        }
+        pos += 12 + len;
+    }
+    if (channels == 0) return false;
+
+    const size_t stride = size_t(width) * channels;
+    std::vector<uint8_t> raw((stride + 1) * size_t(height));
+    uLongf rawLen = uLongf(raw.size());
+    if (uncompress(raw.data(), &rawLen, idat.data(), uLong(idat.size())) != Z_OK || rawLen != raw.size()) return false;
+
+    pixels.resize(stride * size_t(height));
+    for (size_t y = 0; y < height; ++y) {
+        const uint8_t filter = raw[y * (stride + 1)];
+        const uint8_t *src = &raw[y * (stride + 1) + 1];
+        uint8_t *dst = &pixels[y * stride];
+        const uint8_t *up = y > 0 ? dst - stride : nullptr;
+        for (size_t x = 0; x < stride; ++x) {
+            const int a = x >= size_t(channels) ? dst[x - channels] : 0;
+            const int b = up ? up[x] : 0;
+            const int c = (up && x >= size_t(channels)) ? up[x - channels] : 0;
+            switch (filter) {
+            case 0: dst[x] = src[x]; break;
+            case 1: dst[x] = uint8_t(src[x] + a); break;
+            case 2: dst[x] = uint8_t(src[x] + b); break;
+            case 3: dst[x] = uint8_t(src[x] + ((a + b) >> 1)); break;
+            case 4: dst[x] = uint8_t(src[x] + paeth(a, b, c)); break;
+            default: return false;
+            }
+        }
+    }
+    shape = ImageShape{int(width), int(height), channels};
+    return true;
+}
+
+static bool read_pnm(const std::vector<uint8_t> &file, std::vector<uint8_t> &pixels, ImageShape &shape)
+{
+    if (file.size() < 2 || file[0] != 'P' || (file[1] != '5' && file[1] != '6')) return false;
+    size_t pos = 2;
+    uint64_t fields[3] = {0, 0, 0}; // width, height, maxval
+    for (uint64_t &v : fields) {
+        while (pos < file.size() && (std::isspace(file[pos]) || file[pos] == '#')) {
+            if (file[pos] == '#')
+                while (pos < file.size() && file[pos] != '\n') ++pos;
+            else
+                ++pos;
+        }
+        while (pos < file.size() && std::isdigit(file[pos])) {
+            v = v * 10 + uint64_t(file[pos++] - '0');
+            if (v > kMaxImageBytes) return false; // before it can overflow
+        }
+    }
+    ++pos; // single whitespace before the raster
+    const int channels = file[1] == '5' ? 1 : 3;
+    if (fields[2] == 0 || fields[2] > 255 || !valid_shape(fields[0], fields[1], channels)) return false; // 8-bit only
+    const size_t bytes = size_t(fields[0] * fields[1]) * size_t(channels);
+    if (pos > file.size() || bytes > file.size() - pos) return false;
+    pixels.assign(file.begin() + std::ptrdiff_t(pos), file.begin() + std::ptrdiff_t(pos + bytes));
+    shape = ImageShape{int(fields[0]), int(fields[1]), channels};
+    return true;
+}
+
+bool read_image(const std::string &path, std::vector<uint8_t> &pixels, ImageShape &shape)
+{
+    std::ifstream f(path, std::ios::binary);
+    std::vector<uint8_t> file((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+    if (file.empty()) {
+        std::cerr << "ERROR: cannot read image: " << path << "\n";
+        return false;
+    }
+    if (read_png(file, pixels, shape) || read_pnm(file, pixels, shape)) return true;
+    std::cerr << "ERROR: unsupported or damaged image (8-bit PNG without palette/interlace, or binary PGM/PPM): " << path << "\n";
+    return false;
+}
@@ -0,0 +1,55 @@
+#ifndef IMAGE_IO_H
+#define IMAGE_IO_H
+
+#include <Eigen/Dense>
+#include "network.h" // MatrixXfRow
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Pixel layout of one image row in a batch: height x width x channels, interleaved (HWC),
+// so D = width * height * channels. Channels: 1 gray, 2 gray+alpha, 3 RGB, 4 RGBA.
+struct ImageShape
+{
+    int width = 28;
+    int height = 28;
+    int channels = 1;
+    int dim() const { return width * height * channels; }
+    bool operator==(const ImageShape &o) const { return width == o.width && height == o.height && channels == o.channels; }
+    bool operator!=(const ImageShape &o) const { return !(*this == o); }
+};
+
+// How a grid is put on disk.
+//   Pgm         : raw binary PGM (P5) / PPM (P6), no compression at all (1 or 3 channels)
+//   PngStored   : PNG with stored (level 0) deflate blocks, i.e. only framing + checksums
+//   PngFast     : PNG, single-threaded zlib level 1
+//   PngParallel : PNG, rows split into chunks deflated in parallel (pigz-style), any level
+//   PngStb      : the original stbi_write_png path (slowest, smallest files)
+enum class ImageFormat { Pgm, PngStored, PngFast, PngParallel, PngStb };
+
+struct ImageWriteOptions
+{
+    ImageFormat format = ImageFormat::PngFast;
+    int level = 6;   // zlib level, PngParallel only
+    int threads = 0; // chunks for PngParallel, 0 = one per global_pool() thread
+};
+
+void pack_tiles_u8(const MatrixXfRow &batch,
+                   const ImageShape &tile,
+                   int gridCols,
+                   int gridRows,
+                   std::vector<uint8_t> &img);
+
+bool write_image(const std::string &outPath,
+                 const uint8_t *img,
+                 int width,
+                 int height,
+                 int channels,
+                 const ImageWriteOptions &opts = ImageWriteOptions());
+
+// 8-bit PNG (gray, gray+alpha, RGB, RGBA, non-interlaced) or binary PGM/PPM, pixels in HWC order.
+// Returns false, with shape untouched, on a damaged file or one of more than kMaxImageBytes pixels.
+extern const size_t kMaxImageBytes;
+bool read_image(const std::string &path, std::vector<uint8_t> &pixels, ImageShape &shape);
+
+#endif // IMAGE_IO_H
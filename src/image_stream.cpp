@@ -0,0 +1,79 @@
+#include "image_stream.h"
+#include <algorithm>
+#include <iostream>
+
+static uint32_t be32(const unsigned char *b)
+{
+    return (uint32_t(b[0]) << 24) | (uint32_t(b[1]) << 16) | (uint32_t(b[2]) << 8) | uint32_t(b[3]);
+}
+
+/**
+ * @brief Open path and read its header.
+ * @return false (with a message) if the file is missing, truncated, or neither IDX nor a whole
+ * @return number of rawShape images.
+ */
+bool ImageStream::open(const std::string &path, const ImageShape &rawShape)
+{
+    f = std::ifstream(path, std::ios::binary);
+    read_ = 0;
+    failed_ = false;
+    if (!f) {
+        std::cerr << "ERROR: cannot open image file: " << path << "\n";
+        return false;
+    }
+    f.seekg(0, std::ios::end);
+    const size_t bytes = size_t(f.tellg());
+    f.seekg(0);
+
+    unsigned char h[20] = {};
+    f.read((char *)h, sizeof(h));
+    f.clear(); // files shorter than 20 bytes are fine as raw data
+    const uint32_t magic = be32(h);
+    if (magic == 0x803 || magic == 0x804) { // u8 data, 3 or 4 dims
+        count_ = be32(h + 4);
+        shape_ = {int(be32(h + 12)), int(be32(h + 8)), magic == 0x804 ? int(be32(h + 16)) : 1};
+        header = magic == 0x804 ? 20 : 16;
+        if (count_ * size_t(dim()) + header > bytes || dim() == 0) {
+            std::cerr << "ERROR: truncated IDX file: " << path << "\n";
+            return false;
+        }
+        return seek(0);
+    }
+    if (rawShape.dim() <= 0 || bytes % size_t(rawShape.dim()) != 0) {
+        std::cerr << "ERROR: " << path << " is not IDX" << (rawShape.dim() > 0 ? " nor whole raw images" : "; give the raw image shape") << "\n";
+        return false;
+    }
+    shape_ = rawShape;
+    header = 0;
+    count_ = bytes / size_t(rawShape.dim());
+    return seek(0);
+}
+
+bool ImageStream::seek(size_t image)
+{
+    read_ = std::min(image, count_);
+    f.clear();
+    f.seekg(std::streamoff(header + read_ * size_t(dim())));
+    return bool(f);
+}
+
+/**
+ * @brief Read up to maxRows images into chunk (resized to rows x dim()).
+ */
+size_t ImageStream::next(MatrixXu8 &chunk, size_t maxRows)
+{
+    const size_t n = std::min(maxRows, count_ - read_);
+    const size_t d = size_t(dim());
+    if (n == 0) return 0;
+    buffer.resize(n * d);
+    f.read((char *)buffer.data(), std::streamsize(buffer.size()));
+    if (!f) {
+        std::cerr << "ERROR: short read after " << read_ << " images\n";
+        count_ = read_;
+        failed_ = true;
+        return 0;
+    }
+    chunk = Eigen::Map<const Eigen::Matrix<uint8_t, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>>(buffer.data(), Eigen::Index(n), Eigen::Index(d));
+    read_ += n;
+    return n;
+}
@@ -0,0 +1,38 @@
+#ifndef IMAGE_STREAM_H
+#define IMAGE_STREAM_H
+
+#include "image_io.h"
+#include "network.h"
+#include <cstdint>
+#include <fstream>
+#include <string>
+
+/**
+ * @brief Reads an image file front to back (or from any image on) in chunks of rows, never
+ * @brief holding more than one chunk. IDX files carry their own count and shape: u8 with 3 dims
+ * @brief (N, H, W) or 4 dims (N, H, W, C). Any other file is read as raw packed u8 images of
+ * @brief rawShape, HWC order, no header.
+ */
+class ImageStream
+{
+public:
+    bool open(const std::string &path, const ImageShape &rawShape = ImageShape{0, 0, 0}); // dim() 0: IDX only
+    size_t next(MatrixXu8 &chunk, size_t maxRows); // rows read, 0 at the end (or on a short read, see failed())
+    bool seek(size_t image);
+
+    const ImageShape &shape() const { return shape_; }
+    int dim() const { return shape_.dim(); }
+    size_t count() const { return count_; } // images in the file
+    size_t position() const { return read_; }
+    bool failed() const { return failed_; } // a read came up short: the file ended before count() images
+
+private:
+    std::ifstream f;
+    std::vector<uint8_t> buffer;
+    ImageShape shape_{0, 0, 0};
+    size_t header = 0; // bytes before the first image
+    size_t count_ = 0, read_ = 0;
+    bool failed_ = false;
+};
+
+#endif // IMAGE_STREAM_H
@@ -0,0 +1,101 @@
+#include "latent.h"
+#include "profiler.h"
+#include <algorithm>
+#include <cmath>
+
+// ====== SETTINGS ======
+int decode_batch = 128; // 128 x 784 floats of output per block: ~400 KB, inside L2 (bench BM_decode)
+
+/**
+ * @brief codes = tanh(X/255 W1 + b1), forward only, in decode_batch-row blocks on the pool.
+ * @param X const : (N, D) raw pixels.
+ * @param codes REFERENCE : resized to (N, H_size).
+ */
+void encode(const Weights &weights, const MatrixXu8 &X, MatrixXfRow &codes, ThreadPool &pool)
+{
+    PROFILE_SCOPE("encode");
+    codes.resize(X.rows(), weights.W1.cols());
+    pool.parallelForRows(long(X.rows()), decode_batch, [&](long begin, long end) {
+        MatrixXfRow Z = (X.middleRows(begin, end - begin).cast<float>() * (1.0f / 255.0f)) * weights.W1;
+        Z.rowwise() += weights.b1;
+        codes.middleRows(begin, end - begin) = Z.array().tanh().matrix();
+    });
+}
+
+/**
+ * @brief images = sigmoid(tanh(codes W2 + b2) W3 + b3), forward only, in decode_batch-row blocks.
+ * @brief Nothing but the block's two activations is allocated; no loss, no training buffers.
+ * @param codes const : (N, H_size) latents.
+ * @param images REFERENCE : resized to (N, D), values in [0,1], ready for write_png_grid().
+ */
+void decode(const Weights &weights, const MatrixXfRow &codes, MatrixXfRow &images, ThreadPool &pool)
+{
+    PROFILE_SCOPE("decode");
+    images.resize(codes.rows(), weights.W3.cols());
+    pool.parallelForRows(long(codes.rows()), decode_batch, [&](long begin, long end) {
+        MatrixXfRow A2 = codes.middleRows(begin, end - begin) * weights.W2;
+        A2.rowwise() += weights.b2;
+        A2 = A2.array().tanh();
+        MatrixXfRow Y = A2 * weights.W3;
+        Y.rowwise() += weights.b3;
+        images.middleRows(begin, end - begin) = (1.0f / (1.0f + (-Y.array()).exp())).matrix();
+    });
+}
+
+LatentGaussian fit_latent_gaussian(const MatrixXfRow &codes)
+{
+    LatentGaussian g;
+    g.mean = codes.colwise().mean();
+    const MatrixXfRow centered = codes.rowwise() - g.mean;
+    g.stddev = (centered.array().square().colwise().sum() / float(std::max<Eigen::Index>(codes.rows() - 1, 1))).sqrt();
+    return g;
+}
+
+MatrixXfRow sample_latents(const LatentGaussian &prior, int n, std::mt19937 &rng)
+{
+    std::normal_distribution<float> N01(0.0f, 1.0f);
+    MatrixXfRow Zs(n, prior.mean.cols());
+    for (Eigen::Index j = 0; j < Zs.cols(); ++j)
+        for (Eigen::Index i = 0; i < Zs.rows(); ++i)
+            Zs(i, j) = std::clamp(prior.mean(j) + prior.stddev(j) * N01(rng), -0.999f, 0.999f);
+    return Zs;
+}
+
+/**
+ * @brief steps latents from a to b inclusive, straight (lerp) or along the great circle (slerp).
+ * @brief slerp keeps the norm of the codes from dipping in the middle of the path, which for
+ * @brief high-dimensional codes otherwise decodes to washed-out images.
+ */
+MatrixXfRow interpolate_latents(const Eigen::RowVectorXf &a, const Eigen::RowVectorXf &b, int steps, bool spherical)
+{
+    steps = std::max(steps, 2);
+    MatrixXfRow path(steps, a.cols());
+    const float na = a.norm(), nb = b.norm();
+    const float cosOmega = (na > 0 && nb > 0) ? std::clamp(a.dot(b) / (na * nb), -1.0f, 1.0f) : 1.0f;
+    const float omega = std::acos(cosOmega);
+    const bool slerp = spherical && std::sin(omega) > 1e-4f; // nearly parallel: slerp degenerates to lerp
+    for (int s = 0; s < steps; ++s) {
+        const float t = float(s) / float(steps - 1);
+        if (slerp)
+            path.row(s) = (std::sin((1 - t) * omega) * a + std::sin(t * omega) * b) / std::sin(omega);
+        else
+            path.row(s) = (1 - t) * a + t * b;
+    }
+    return path;
+}
+
+/**
+ * @brief cols x rows latents origin + x u + y v, x and y evenly spaced in [-1, 1], row-major grid order.
+ */
+MatrixXfRow latent_grid(const Eigen::RowVectorXf &origin, const Eigen::RowVectorXf &u, const Eigen::RowVectorXf &v,
+                        int cols, int rows)
+{
+    MatrixXfRow grid(Eigen::Index(cols) * rows, origin.cols());
+    for (int y = 0; y < rows; ++y)
+        for (int x = 0; x < cols; ++x) {
+            const float fx = cols > 1 ? 2.0f * x / float(cols - 1) - 1.0f : 0.0f;
+            const float fy = rows > 1 ? 2.0f * y / float(rows - 1) - 1.0f : 0.0f;
+            grid.row(Eigen::Index(y) * cols + x) = (origin + fx * u + fy * v).cwiseMax(-0.999f).cwiseMin(0.999f);
+        }
+    return grid;
+}
@@ -0,0 +1,33 @@
+#ifndef LATENT_H
+#define LATENT_H
+
+#include "network.h"
+#include "thread_pool.h"
+#include <random>
+
+// The code of an image is the first hidden layer, H = tanh(X W1 + b1): H_size values in (-1, 1).
+// The decoder is the rest of the network, sigmoid(tanh(H W2 + b2) W3 + b3).
+
+// ====== SETTINGS ======
+extern int decode_batch; // latent rows per decoder call, sized so a block's activations stay in cache
+
+void encode(const Weights &weights, const MatrixXu8 &X, MatrixXfRow &codes, ThreadPool &pool = global_pool());
+void decode(const Weights &weights, const MatrixXfRow &codes, MatrixXfRow &images, ThreadPool &pool = global_pool());
+
+/**
+ * @brief Diagonal Gaussian fitted to encoded images. The autoencoder has no prior of its own,
+ * @brief so "prior" draws come from this fit, clamped to the tanh range.
+ */
+struct LatentGaussian
+{
+    Eigen::RowVectorXf mean;
+    Eigen::RowVectorXf stddev;
+};
+
+LatentGaussian fit_latent_gaussian(const MatrixXfRow &codes);
+MatrixXfRow sample_latents(const LatentGaussian &prior, int n, std::mt19937 &rng);
+MatrixXfRow interpolate_latents(const Eigen::RowVectorXf &a, const Eigen::RowVectorXf &b, int steps, bool spherical);
+MatrixXfRow latent_grid(const Eigen::RowVectorXf &origin, const Eigen::RowVectorXf &u, const Eigen::RowVectorXf &v,
+                        int cols, int rows);
+
+#endif // LATENT_H
@@ -0,0 +1,235 @@
+#include "latent_index.h"
+#include "profiler.h"
+#include <algorithm>
+#include <numeric>
+#include <random>
+
+// ====== SETTINGS ======
+int knn_block_rows = 4096; // 64 queries x 4096 rows of distances = 1 MB tile
+int knn_query_block = 64;
+int ivf_train_iters = 10;
+int ivf_train_samples = 20000;
+
+// ------------------------------------------------------------
+// Top-k selection: bounded max-heap on distance, worst neighbour on top
+// ------------------------------------------------------------
+static bool closer(const Neighbor &a, const Neighbor &b)
+{
+    return a.dist < b.dist || (a.dist == b.dist && a.id < b.id); // ties by id, so results are reproducible
+}
+
+static void push_topk(std::vector<Neighbor> &heap, int k, Neighbor n)
+{
+    if (k <= 0) return; // heap.front() below needs a non-empty heap
+    if (int(heap.size()) < k) {
+        heap.push_back(n);
+        std::push_heap(heap.begin(), heap.end(), closer);
+    } else if (closer(n, heap.front())) {
+        std::pop_heap(heap.begin(), heap.end(), closer);
+        heap.back() = n;
+        std::push_heap(heap.begin(), heap.end(), closer);
+    }
+}
+
+static std::vector<Neighbor> sorted(std::vector<Neighbor> heap)
+{
+    std::sort_heap(heap.begin(), heap.end(), closer);
+    return heap;
+}
+
+/**
+ * @brief Fold one tile of distances into the per-query heaps.
+ * @param dots const : (q, n) query . row products for the tile.
+ * @param ids Maps tile column j to its id; nullptr means id = firstId + j.
+ */
+static void scan_tile(const MatrixXfRow &dots, const Eigen::VectorXf &rowNorms, const Eigen::VectorXf &queryNorms,
+                      const int *ids, int firstId, int k, std::vector<std::vector<Neighbor>> &heaps, int firstQuery)
+{
+    for (Eigen::Index q = 0; q < dots.rows(); ++q) {
+        std::vector<Neighbor> &heap = heaps[size_t(firstQuery + q)];
+        for (Eigen::Index j = 0; j < dots.cols(); ++j) {
+            const float d = std::max(0.0f, rowNorms(j) - 2.0f * dots(q, j) + queryNorms(q)); // clamp cancellation error
+            if (int(heap.size()) == k && d > heap.front().dist) continue;
+            push_topk(heap, k, {ids ? ids[j] : firstId + int(j), d});
+        }
+    }
+}
+
+
+// ------------------------------------------------------------
+// Flat (exact) index
+// ------------------------------------------------------------
+void FlatIndex::add(const MatrixXfRow &codes)
+{
+    if (data.size() == 0) data.resize(0, codes.cols());
+    const Eigen::Index old = data.rows();
+    data.conservativeResize(old + codes.rows(), codes.cols());
+    data.bottomRows(codes.rows()) = codes;
+    norms.conservativeResize(data.rows());
+    norms.tail(codes.rows()) = codes.rowwise().squaredNorm();
+}
+
+/**
+ * @brief One query: a single GEMV over every row, then a heap pass.
+ */
+std::vector<Neighbor> FlatIndex::search(const Eigen::RowVectorXf &query, int k) const
+{
+    PROFILE_SCOPE("knn.flat");
+    k = std::min(k, size()); // k <= 0 or an empty index: no neighbours
+    if (k <= 0) return {};
+    const Eigen::VectorXf dots = data * query.transpose();
+    const float qn = query.squaredNorm();
+    std::vector<Neighbor> heap;
+    heap.reserve(size_t(k));
+    for (Eigen::Index i = 0; i < dots.size(); ++i) {
+        const float d = std::max(0.0f, norms(i) - 2.0f * dots(i) + qn);
+        if (int(heap.size()) == k && d > heap.front().dist) continue;
+        push_topk(heap, k, {int(i), d});
+    }
+    return sorted(std::move(heap));
+}
+
+/**
+ * @brief Batch queries: knn_query_block queries per pool task, each sweeping the database in
+ * @brief knn_block_rows tiles with one GEMM per tile.
+ */
+std::vector<std::vector<Neighbor>> FlatIndex::search(const MatrixXfRow &queries, int k, ThreadPool &pool) const
+{
+    PROFILE_SCOPE("knn.flat_batch");
+    std::vector<std::vector<Neighbor>> heaps(size_t(queries.rows()));
+    k = std::min(k, size());
+    if (k <= 0) return heaps; // one empty result per query
+    const Eigen::VectorXf queryNorms = queries.rowwise().squaredNorm();
+    pool.parallelForRows(long(queries.rows()), knn_query_block, [&](long q0, long q1) {
+        const MatrixXfRow Q = queries.middleRows(q0, q1 - q0);
+        const Eigen::VectorXf qn = queryNorms.segment(q0, q1 - q0);
+        MatrixXfRow dots;
+        for (Eigen::Index r0 = 0; r0 < data.rows(); r0 += knn_block_rows) {
+            const Eigen::Index n = std::min<Eigen::Index>(knn_block_rows, data.rows() - r0);
+            dots.noalias() = Q * data.middleRows(r0, n).transpose();
+            scan_tile(dots, norms.segment(r0, n), qn, nullptr, int(r0), k, heaps, int(q0));
+        }
+    });
+    for (auto &h : heaps) h = sorted(std::move(h));
+    return heaps;
+}
+
+
+// ------------------------------------------------------------
+// IVF (approximate) index
+// ------------------------------------------------------------
+IVFIndex::IVFIndex(int nlist, uint32_t seed) : lists_wanted(std::max(nlist, 1)), seed(seed) {}
+
+/**
+ * @brief k-means (Lloyd) on a sample of the codes; assignments use the flat batch search.
+ * @brief Empty clusters are re-seeded from a random sample so every list stays usable.
+ */
+void IVFIndex::train(const MatrixXfRow &codes, ThreadPool &pool)
+{
+    PROFILE_SCOPE("ivf.train");
+    std::mt19937 rng(seed);
+    std::vector<int> order(size_t(codes.rows()));
+    std::iota(order.begin(), order.end(), 0);
+    std::shuffle(order.begin(), order.end(), rng);
+    const int n = std::min<int>(int(codes.rows()), std::max(ivf_train_samples, lists_wanted));
+    MatrixXfRow sample(n, codes.cols());
+    for (int i = 0; i < n; ++i) sample.row(i) = codes.row(order[size_t(i)]);
+
+    const int nl = std::min(lists_wanted, n);
+    MatrixXfRow C = sample.topRows(nl);
+    std::uniform_int_distribution<int> pick(0, n - 1);
+    for (int it = 0; it < ivf_train_iters; ++it) {
+        FlatIndex current;
+        current.add(C);
+        const auto nearest = current.search(sample, 1, pool);
+        MatrixXfRow sums = MatrixXfRow::Zero(nl, codes.cols());
+        Eigen::VectorXi counts = Eigen::VectorXi::Zero(nl);
+        for (int i = 0; i < n; ++i) {
+            sums.row(nearest[size_t(i)][0].id) += sample.row(i);
+            ++counts(nearest[size_t(i)][0].id);
+        }
+        for (int c = 0; c < nl; ++c)
+            C.row(c) = counts(c) > 0 ? Eigen::RowVectorXf(sums.row(c) / float(counts(c))) : Eigen::RowVectorXf(sample.row(pick(rng)));
+    }
+    centroids = FlatIndex();
+    centroids.add(C);
+    lists.assign(size_t(nl), List());
+    count = 0;
+}
+
+void IVFIndex::add(const MatrixXfRow &codes, ThreadPool &pool)
+{
+    PROFILE_SCOPE("ivf.add");
+    const auto nearest = centroids.search(codes, 1, pool);
+    std::vector<std::vector<int>> members(lists.size());
+    for (int i = 0; i < int(codes.rows()); ++i) members[size_t(nearest[size_t(i)][0].id)].push_back(i);
+
+    pool.parallelFor(int(lists.size()), [&](int l) {
+        List &list = lists[size_t(l)];
+        const std::vector<int> &m = members[size_t(l)];
+        const Eigen::Index old = list.codes.rows();
+        list.codes.conservativeResize(old + Eigen::Index(m.size()), codes.cols());
+        for (size_t j = 0; j < m.size(); ++j) {
+            list.codes.row(old + Eigen::Index(j)) = codes.row(m[j]);
+            list.ids.push_back(count + m[j]);
+        }
+        list.norms = list.codes.rowwise().squaredNorm();
+    });
+    count += int(codes.rows());
+}
+
+std::vector<Neighbor> IVFIndex::search(const Eigen::RowVectorXf &query, int k, int nprobe) const
+{
+    PROFILE_SCOPE("knn.ivf");
+    k = std::min(k, size());
+    if (k <= 0) return {};
+    const std::vector<Neighbor> probes = centroids.search(query, std::min(nprobe, nlist()));
+    const float qn = query.squaredNorm();
+    std::vector<Neighbor> heap;
+    heap.reserve(size_t(k));
+    for (const Neighbor &p : probes) {
+        const List &list = lists[size_t(p.id)];
+        if (list.ids.empty()) continue;
+        const Eigen::VectorXf dots = list.codes * query.transpose();
+        for (Eigen::Index i = 0; i < dots.size(); ++i) {
+            const float d = std::max(0.0f, list.norms(i) - 2.0f * dots(i) + qn);
+            if (int(heap.size()) == k && d > heap.front().dist) continue;
+            push_topk(heap, k, {list.ids[size_t(i)], d});
+        }
+    }
+    return sorted(std::move(heap));
+}
+
+/**
+ * @brief Batch queries, one pool task per knn_query_block queries; each query scans its own lists.
+ */
+std::vector<std::vector<Neighbor>> IVFIndex::search(const MatrixXfRow &queries, int k, int nprobe, ThreadPool &pool) const
+{
+    std::vector<std::vector<Neighbor>> results(size_t(queries.rows()));
+    if (std::min(k, size()) <= 0) return results;
+    pool.parallelForRows(long(queries.rows()), knn_query_block, [&](long q0, long q1) {
+        for (long q = q0; q < q1; ++q) results[size_t(q)] = search(Eigen::RowVectorXf(queries.row(q)), k, nprobe);
+    });
+    return results;
+}
+
+/**
+ * @brief Fraction of the exact k nearest ids that the approximate search also returned.
+ */
+double recall_at_k(const std::vector<std::vector<Neighbor>> &exact, const std::vector<std::vector<Neighbor>> &approx, int k)
+{
+    const size_t kk = size_t(std::max(k, 0));
+    size_t hits = 0, total = 0;
+    for (size_t q = 0; q < exact.size() && q < approx.size(); ++q) {
+        const size_t n = std::min(exact[q].size(), kk);
+        for (size_t i = 0; i < n; ++i) {
+            ++total;
+            for (size_t j = 0; j < approx[q].size() && j < kk; ++j)
+                if (approx[q][j].id == exact[q][i].id) {
+                    ++hits;
+                    break;
+                }
+        }
+    }
+    return total ? double(hits) / double(total) : 1.0;
+}
@@ -0,0 +1,78 @@
+#ifndef LATENT_INDEX_H
+#define LATENT_INDEX_H
+
+#include "network.h"
+#include "thread_pool.h"
+#include <vector>
+
+// ====== SETTINGS ======
+extern int knn_block_rows;    // database rows per distance tile in batch search
+extern int knn_query_block;   // queries per tile (and per pool task) in batch search
+extern int ivf_train_iters;   // Lloyd iterations when training the IVF centroids
+extern int ivf_train_samples; // codes sampled for training the IVF centroids
+
+struct Neighbor
+{
+    int id;
+    float dist; // squared L2
+};
+
+/**
+ * @brief Exact k-NN by brute force over codes stored row-major with their squared norms.
+ * @brief ||x - q||^2 = ||x||^2 - 2 x.q + ||q||^2, so one query is one matrix-vector product and
+ * @brief a batch of queries is one GEMM per (query block, database block) tile, both vectorised
+ * @brief by Eigen; only the k best of each tile row survive into a per-query max-heap.
+ * @brief k is clamped to size(): k <= 0 or an empty index gives empty results.
+ */
+class FlatIndex
+{
+public:
+    void add(const MatrixXfRow &codes); // ids continue from size()
+    int size() const { return int(data.rows()); }
+    int dim() const { return int(data.cols()); }
+
+    std::vector<Neighbor> search(const Eigen::RowVectorXf &query, int k) const;
+    std::vector<std::vector<Neighbor>> search(const MatrixXfRow &queries, int k, ThreadPool &pool = global_pool()) const;
+
+private:
+    friend class IVFIndex;
+    MatrixXfRow data;
+    Eigen::VectorXf norms;
+};
+
+/**
+ * @brief Approximate k-NN: codes bucketed by their nearest of nlist k-means centroids; a query
+ * @brief scans only its nprobe nearest buckets. Each bucket is a contiguous row-major block.
+ * @brief As for FlatIndex, k is clamped to size(); nprobe <= 0 probes nothing.
+ */
+class IVFIndex
+{
+public:
+    IVFIndex(int nlist, uint32_t seed = 1234);
+
+    void train(const MatrixXfRow &codes, ThreadPool &pool = global_pool());
+    void add(const MatrixXfRow &codes, ThreadPool &pool = global_pool());
+    int size() const { return count; }
+    int nlist() const { return int(centroids.data.rows()); }
+
+    std::vector<Neighbor> search(const Eigen::RowVectorXf &query, int k, int nprobe) const;
+    std::vector<std::vector<Neighbor>> search(const MatrixXfRow &queries, int k, int nprobe, ThreadPool &pool = global_pool()) const;
+
+private:
+    struct List
+    {
+        MatrixXfRow codes;
+        Eigen::VectorXf norms;
+        std::vector<int> ids;
+    };
+
+    FlatIndex centroids;
+    std::vector<List> lists;
+    int lists_wanted;
+    uint32_t seed;
+    int count = 0;
+};
+
+double recall_at_k(const std::vector<std::vector<Neighbor>> &exact, const std::vector<std::vector<Neighbor>> &approx, int k);
+
+#endif // LATENT_INDEX_H
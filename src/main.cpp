@@ -5,68 +5,135 @@
 #include <cmath>
 #include <sstream>
 #include <iomanip>
+#include <cstdio>
+#include <cstring>
 
 #include "shape.h"
+#include "augment.h"
 #include "network.h"
+#include "snapshot.h"
+#include "profiler.h"
+#include "thread_pool.h"
+#include "train.h"
+#include "eval.h"
+#include "weight_store.h"
 
-void generateOutput(std::__1::mt19937 &rng, ForwardOutput &forward, const Weights &weights, int iteration);
+void generateOutput(std::mt19937 &rng, ForwardOutput &evalForward, const Weights &weights, int iteration, SnapshotWriter &snapshots);
 size_t iterations = 50000;
+size_t snapshot_depth = 4; // grids that may wait for the PNG writer before new ones are dropped
+std::string checkpoint_path = "vae_checkpoint.bin";
 
-int main()
+// Usage: main [--train SPEC] [--test SPEC] [--raw WxHxC] [--cache DIR] [--iterations N] [--activation-mb MB]
+//             [--augment shift=P,rotate=DEG,scale=F,elastic=P,cell=P,noise=S]
+// SPEC is an IDX or raw file, a directory of PNG/PGM/PPM images, or shards:DIR (see open_dataset()).
+// --raw gives the image shape of headerless raw files and shards.
+// --cache keeps the decoded datasets in DIR, mapped and shared by every run pointing there.
+// --activation-mb caps the batch-sized buffers per worker; past it the output layer is recomputed.
+// --augment distorts every training batch as it is drawn (any subset of the stages, see augment.h).
+int main(int argc, char **argv)
 {
-    std::mt19937 rng(1337u); // random generator
+    for (int i = 1; i < argc; ++i) {
+        auto next = [&]() { return (i + 1 < argc) ? argv[++i] : (std::cerr << "missing value for " << argv[i] << "\n", std::exit(2), nullptr); };
+        if (parse_dataset_flag(argc, argv, i)) continue; // --train --test --raw --cache
+        if (!std::strcmp(argv[i], "--iterations")) iterations = size_t(std::atol(next()));
+        else if (!std::strcmp(argv[i], "--activation-mb")) activation_budget = size_t(std::atof(next()) * 1e6);
+        else if (!std::strcmp(argv[i], "--augment")) {
+            if (!set_augment(next())) return 2;
+        }
+        else {
+            std::cerr << "usage: " << argv[0] << dataset_flags_usage << " [--iterations N] [--activation-mb MB]"
+                      << " [--augment shift=P,rotate=DEG,scale=F,elastic=P,cell=P,noise=S]\n";
+            return 2;
+        }
+    }
+    load_datasets(); // D comes from the images, before anything is sized from it
+
+    std::mt19937 rng(1337u); // random generator (snapshots; the trainer has its own streams)
     
 
-    Eigen::MatrixXf X = make_batch_mnist(B, rng, true);
     Weights weights;
-    ForwardOutput forward;
-    Gradients gradients;
+    ForwardOutput evalForward; // reconstructions never overwrite the training activations
+    Trainer trainer(global_pool(), accum_steps, 1337u); // accum_steps micro-batches of B per update
+    SnapshotWriter snapshots(snapshot_depth);
+    MetricsSink metrics("train_metrics.csv", "train_metrics.jsonl"); // per-phase timings need make PROFILE=1
+    WeightPublisher publisher; // versions readers can hold while training goes on
+    Evaluator evaluator;       // test-set passes on a published version, in the background
+    std::future<bool> checkpointDone;
+    EvalResult eval;
+    bool evalFresh = false;
+    double loss = 0.0;
     for (size_t i = 0; i <= iterations; i++)
     {
-        X = make_batch_mnist(B, rng, true);
-        forwardPass(forward, weights, X);
-        backPass(gradients, forward, weights, X);
-        backProp(weights,gradients);
+        loss = trainer.step(weights);
+        const bool evalDue = eval_every > 0 && i % size_t(eval_every) == 0;
+        const bool checkpointDue = checkpoint_every > 0 && i % size_t(checkpoint_every) == 0 && i > 0;
+        if (i % size_t(std::max(publish_every, 1)) == 0 || evalDue || checkpointDue)
+            publisher.publish(weights, i);
+        if (evalDue)
+            evaluator.start(publisher.acquire());
+        if (checkpointDue && (!checkpointDone.valid() || checkpointDone.wait_for(std::chrono::seconds(0)) == std::future_status::ready))
+            checkpointDone = global_pool().submit([pinned = publisher.acquire()] {
+                return save_checkpoint(checkpoint_path, pinned.weights(), pinned.iteration());
+            });
+        if (evaluator.poll(eval))
+        {
+            std::cout << "test BCE after " << eval.iteration << " iterations : " << eval.bce << " (" << eval.images
+                      << " images, " << eval.seconds << " s)" << std::endl;
+            evalFresh = true;
+        }
         if ( i % 100 == 0)
         {
-            std::cout << "loss after :" << i << "iterations : "; forward.lossPrint();
+            std::cout << "loss after :" << i << "iterations : " << "The loss is : " << loss << std::endl;
+            if (evalFresh)
+                metrics.flush(i, {{"loss", loss}, {"test_bce", eval.bce}, {"test_bce_iteration", double(eval.iteration)}});
+            else
+                metrics.flush(i, {{"loss", loss}});
+            evalFresh = false;
         }
         if(i % 500 == 0)
         {
-            generateOutput(rng, forward, weights, i);
+            generateOutput(rng, evalForward, weights, i, snapshots);
         }
         
     }
-    std::cout << "Loss after 100 iterations : ";forward.lossPrint();
+    std::cout << "Loss after " << iterations << " iterations : " << loss << std::endl;
+    eval = evaluate(weights);
+    std::cout << "Final test BCE : " << eval.bce << " (" << eval.images << " images, " << eval.seconds << " s)" << std::endl;
+    if (checkpointDone.valid()) global_pool().wait(checkpointDone); // still holds a pinned version
+    if (save_checkpoint(checkpoint_path, weights, iterations))
+        std::cout << "Saved " << checkpoint_path << "\n";
+    snapshots.flush();
+    if (snapshots.dropped() > 0)
+        std::cout << "Dropped " << snapshots.dropped() << " snapshots (writer busy)\n";
+#ifdef VAE_PROFILE
+    profiler_write_chrome_trace("train_trace.json");
+#endif
     return 0;
 }
 
 
-void generateOutput(std::mt19937 &rng, ForwardOutput& forward, const Weights& weights, int iteration)
+/**
+ * @brief Reconstruct a batch with the current weights and queue input/output grids for writing.
+ * @param evalForward REFERENCE : Evaluation-only activations, separate from the training ones.
+ * @param snapshots REFERENCE : Background writer; the PNG encoding happens off this thread.
+ */
+void generateOutput(std::mt19937 &rng, ForwardOutput& evalForward, const Weights& weights, int iteration, SnapshotWriter &snapshots)
 {
     // Load an image
-    Eigen::MatrixXf X_test = make_batch_mnist(B, rng, true);
+    MatrixXfRow X_test = make_batch(B, rng, false); // held-out images
     std::ostringstream inputPath;
     inputPath << "/Users/daboi/Documents/Projects/VAE/Intelligent_Data_Compression_Framework/assets/"<< "INPUT_After_" << std::setw(5) << std::setfill('0') << iteration << ".png";
 
-    forwardPass(forward, weights, X_test);
+    PROFILE_SCOPE("snapshot.submit");
+    forwardPass(evalForward, weights, X_test);
 
     // Save
     std::ostringstream path;
     path << "/Users/daboi/Documents/Projects/VAE/Intelligent_Data_Compression_Framework/assets/"<< "OUTPUT_After_" << std::setw(5) << std::setfill('0') << iteration << ".png";
 
-    // Sauvegarde de la reconstruction
-    bool input = write_png_grid_mnist(X_test, 4, 4, inputPath.str()) ;
-    bool ok = write_png_grid_mnist(forward.sigmoid, 4, 4, path.str());
-
-    if (!input) {
-        std::cerr << " Failed to write " << inputPath.str() << "\n";
-    } else {
-        std::cout << "Saved " << inputPath.str() << "\n";
-    }
-    if (!ok) {
-        std::cerr << " Failed to write " << path.str() << "\n";
-    } else {
-        std::cout << "Saved " << path.str() << "\n";
-    }
-}
\ No newline at end of file
+    // Sauvegarde de la reconstruction (copied into the writer's ring, encoded in the background)
+    if (!snapshots.submit(X_test, 4, 4, inputPath.str()))
+        std::cerr << " Snapshot queue full, skipped " << inputPath.str() << "\n";
+    if (!snapshots.submit(evalForward.sigmoid, 4, 4, path.str()))
+        std::cerr << " Snapshot queue full, skipped " << path.str() << "\n";
+}
@@ -1,21 +1,29 @@
 #include "network.h"
+#include "profiler.h"
+#include <algorithm>
 #include <cmath>
 #include <stdexcept>
+#include <type_traits>
 
 // ====== SETTINGS ======
 int H_size = 128;
 int D = 784;
 int B = 64;
 double lr = 0.01f;
+float sparse_density_threshold = 0.35f; // dense/CSR crossover measured on 64x784x128 (bench BM_first_layer_*)
+bool fused_backward = true;
+int backward_tile_cols = 128; // B x 128 floats of Gy per tile: 32 KB at B = 64 (bench BM_backPass_fused)
 auto xavier = [](int fan_in, int fan_out){ return std::sqrt(2.0f / float(fan_in + fan_out)); };
 
-Weights::Weights() : W1(Eigen::MatrixXf::Random(D,H_size) * xavier(D, H_size)),
-                     b1(Eigen::MatrixXf::Zero(1,H_size)),
-                     W2(Eigen::MatrixXf::Random(H_size,H_size) * xavier(H_size, H_size)),
-                     b2(Eigen::MatrixXf::Zero(1,H_size)),
-                     W3(Eigen::MatrixXf::Random(H_size,D) * xavier(H_size, D)),
-                     b3(Eigen::MatrixXf::Zero(1,D))
-                     {}
+Weights::Weights() : Weights(D, H_size) {}
+
+Weights::Weights(int inputs, int hidden) : W1(Eigen::MatrixXf::Random(inputs,hidden) * xavier(inputs, hidden)),
+                                           b1(Eigen::MatrixXf::Zero(1,hidden)),
+                                           W2(Eigen::MatrixXf::Random(hidden,hidden) * xavier(hidden, hidden)),
+                                           b2(Eigen::MatrixXf::Zero(1,hidden)),
+                                           W3(Eigen::MatrixXf::Random(hidden,inputs) * xavier(hidden, inputs)),
+                                           b3(Eigen::MatrixXf::Zero(1,inputs))
+                                           {}
 /**
 * @brief Print first 5X5 matrixes of W1 & W2 and print b1 & b2.
 * @brief Throw exeption if too small
@@ -39,54 +47,339 @@ void Weights::print()
     }
 }
 
-ForwardOutput::ForwardOutput() : Z(B, H_size),
-                                 H(B, H_size), 
-                                 Z2(B,H_size),
-                                 A2(B,H_size),
-                                 Yhat(B, D),
-                                 sigmoid(B,D) 
-                                 {}
+ForwardOutput::ForwardOutput(bool keepOutput) : H(B, H_size), 
+                                                A2(B,H_size),
+                                                sigmoid(keepOutput ? B : 0, keepOutput ? D : 0),
+                                                tile(keepOutput ? 0 : B, keepOutput ? 0 : std::min(backward_tile_cols, D)),
+                                                keepOutput(keepOutput)
+                                                {}
 void ForwardOutput::lossPrint()
 {
     std::cout << "The loss is : " << this->loss << std::endl;
 }
 
-Gradients::Gradients() : Gy(B, D), 
-                         Gw3(H_size,D),
-                         Ga2(B,H_size),
-                         Gz2(B,H_size),
-                         Gw2(H_size, H_size), 
-                         Gh(B, H_size), 
-                         Gz(B, H_size), 
-                         Gw1(D, H_size),
-                         Gb3(1,D),
-                         Gb2(1, H_size), 
-                         Gb1(1, H_size)
-                         {}
+Gradients::Gradients(bool weightGradients) : Gz2(B,H_size),
+                                              Gz(B, H_size), 
+                                              Gb3(1,D),
+                                              Gb2(1, H_size), 
+                                              Gb1(1, H_size),
+                                              tile(B, backward_tile_cols)
+{
+    if (!weightGradients) return;
+    Gw3.resize(H_size, D);
+    Gw2.resize(H_size, H_size);
+    Gw1.resize(D, H_size);
+}
+
+
+/**
+ * @brief Bytes of the batch-sized buffers a training step holds: the ForwardOutput and the
+ * @brief activation-sized Gradients buffers of the fused backward (weight gradients excluded).
+ * @brief Not keeping the output replaces the (batch, D) sigmoid with a (batch, tile) slice.
+ */
+size_t activation_bytes(int batch, bool keepOutput)
+{
+    const size_t tile = size_t(std::min(std::max(backward_tile_cols, 1), std::max(D, H_size)));
+    const size_t forward = size_t(batch) * (2 * size_t(H_size) + (keepOutput ? size_t(D) : tile));
+    const size_t backward = size_t(batch) * (2 * size_t(H_size) + tile); // Gz2, Gz, tile
+    return (forward + backward) * sizeof(float);
+}
+
+/**
+ * @brief True when the batch is sparse enough for the CSR first-layer kernels to beat the dense GEMM.
+ */
+bool useSparseInput(const SparseBatch& Xs)
+{
+    const double density = double(Xs.nonZeros()) / double(std::max<Eigen::Index>(Xs.rows() * Xs.cols(), 1));
+    return density < sparse_density_threshold;
+}
+
+// Pixels reach the network either as floats in [0,1] or as raw bytes. For bytes, the /255
+// is applied in the u8 -> f32 conversion of a column slice of X that feeds the first layer's
+// GEMMs (see inputTiles) and inside the loss expressions, so no float copy of X is ever stored.
+template <typename Derived>
+static float input_scale()
+{
+    return std::is_same<typename Derived::Scalar, float>::value ? 1.0f : 1.0f / 255.0f;
+}
+
+/**
+ * @brief Calls use(c, cw, T) for every column slice [c, c+cw) of u8 X, with T (B, cw) that slice
+ * @brief converted and scaled to [0,1] in tile. Eigen would evaluate a cast GEMM operand into a
+ * @brief whole (B, D) float matrix; a slice of backward_tile_cols columns stays in cache.
+ */
+template <typename Derived, typename UseFn>
+static void inputTiles(const Eigen::MatrixBase<Derived>& X, MatrixXfRow& tile, const UseFn& use)
+{
+    const Eigen::Index n = X.cols();
+    const Eigen::Index w = std::min<Eigen::Index>(std::max(backward_tile_cols, 1), n);
+    if (tile.rows() != X.rows() || tile.cols() < w) tile.resize(X.rows(), w);
+    for (Eigen::Index c = 0; c < n; c += w) {
+        const Eigen::Index cw = std::min(w, n - c);
+        auto T = tile.leftCols(cw);
+        T = X.middleCols(c, cw).template cast<float>() * input_scale<Derived>();
+        use(c, cw, T);
+    }
+}
+
+/**
+ * @brief One column slice of the output, sigmoid(A2 W3[:, c..c+cw) + b3[c..c+cw)), into T.
+ * @brief Used when the (B, D) output is not kept: the forward scores it slice by slice and the
+ * @brief backward rebuilds each slice from A2 (an extra B x H x D GEMM) right where it is consumed.
+ */
+template <typename Tile>
+static void outputSlice(const ForwardOutput& forward, const Weights& weights, Eigen::Index c, Eigen::Index cw, Tile& T)
+{
+    T.noalias() = forward.A2 * weights.W3.middleCols(c, cw);
+    T.rowwise() += weights.b3.segment(c, cw);
+    T = 1.0f / (1.0f + (-T.array()).exp());
+}
+
+template <typename Derived>
+static void forwardImpl(ForwardOutput& forward, const Weights& weights, const Eigen::MatrixBase<Derived>& X, const SparseBatch* Xs)
+{
+    const float scale = input_scale<Derived>();
+    // Pre-activations are built in the activation buffers and squashed in place: Z, Z2 and
+    // the output logits are never needed by the backward, so they are never stored.
+    {
+        PROFILE_SCOPE("forward.gemm1");
+        if (Xs)
+            forward.H.noalias() = *Xs * weights.W1; // only the nonzero pixels touch W1 rows
+        else if constexpr (std::is_same<typename Derived::Scalar, float>::value)
+            forward.H.noalias() = X * weights.W1;
+        else {
+            forward.H.setZero(X.rows(), weights.W1.cols());
+            inputTiles(X, forward.tile, [&](Eigen::Index c, Eigen::Index cw, const auto& T) {
+                forward.H.noalias() += T * weights.W1.middleRows(c, cw);
+            });
+        }
+        forward.H.rowwise() += weights.b1;
+    }
+    {
+        PROFILE_SCOPE("forward.tanh1");
+        forward.H = forward.H.array().tanh(); // element wise
+    }
+    {
+        PROFILE_SCOPE("forward.gemm2");
+        forward.A2.noalias() = forward.H * weights.W2;
+        forward.A2.rowwise() += weights.b2;
+    }
+    {
+        PROFILE_SCOPE("forward.tanh2");
+        forward.A2 = forward.A2.array().tanh();
+    }
+    if (!forward.keepOutput)
+    {
+        PROFILE_SCOPE("forward.output_tiles");
+        const Eigen::Index n = weights.W3.cols();
+        const Eigen::Index w = std::min<Eigen::Index>(std::max(backward_tile_cols, 1), n);
+        if (forward.tile.rows() != X.rows() || forward.tile.cols() < w) forward.tile.resize(X.rows(), w);
+        double sum = 0.0;
+        for (Eigen::Index c = 0; c < n; c += w) {
+            const Eigen::Index cw = std::min(w, n - c);
+            auto T = forward.tile.leftCols(cw);
+            outputSlice(forward, weights, c, cw, T);
+            const auto x = X.middleCols(c, cw).template cast<float>().array() * scale;
+            sum += (-(x * T.array().log() + (1 - x) * (1 - T.array()).log())).sum();
+        }
+        forward.loss = sum / (double(X.rows()) * n);
+        return;
+    }
+    {
+        PROFILE_SCOPE("forward.gemm3");
+        forward.sigmoid.noalias() = forward.A2 * weights.W3;
+        forward.sigmoid.rowwise() += weights.b3;
+    }
+    {
+        PROFILE_SCOPE("forward.sigmoid");
+        forward.sigmoid = 1.0 / (1.0 + (-forward.sigmoid.array()).exp()); // sigmoid element wise
+    }
+    PROFILE_SCOPE("forward.loss");
+    const auto x = X.template cast<float>().array() * scale;
+    forward.loss = (-(x * forward.sigmoid.array().log() // every element compute -xlog(...)
+                      + (1 - x) * (1 - forward.sigmoid.array()).log())).mean(); // mean over all entries in batch, mean over B & D !
+}
+
+/**
+ * @brief Columns [c, c+cw) of the output-layer gradient (sigmoid - x) / BD, into T.
+ */
+template <typename Derived, typename Tile>
+static void outputGradient(const ForwardOutput& forward, const Weights& weights, const Eigen::MatrixBase<Derived>& X,
+                           Eigen::Index c, Eigen::Index cw, Tile& T)
+{
+    const auto x = X.middleCols(c, cw).template cast<float>().array() * input_scale<Derived>();
+    if (forward.keepOutput) {
+        T = (forward.sigmoid.middleCols(c, cw).array() - x) / float(B * D);
+    } else {
+        outputSlice(forward, weights, c, cw, T);
+        T = (T.array() - x) / float(B * D);
+    }
+}
 
+/**
+ * @brief One layer's backward as a single sweep over column tiles of its incoming gradient G (B, n).
+ * @brief Each tile is produced once into a small buffer by tileOf(c, cw, T) and, while it is still
+ * @brief in cache, gives its columns of dW = A^T G and db = colsum(G) and its share of G W^T.
+ * @brief For the output layer tileOf evaluates (sigmoid - x) / BD, so that G is never stored whole.
+ * @param A const : (B, m) input activation of the layer, tanh output.
+ * @param Gx Optional : receives (G W^T) * (1 - A^2), the gradient at the pre-activation of A.
+ */
+template <typename TileFn, typename Weight, typename WeightGrad>
+static void fusedLayerBackward(Eigen::Index n, const TileFn& tileOf, const MatrixXfRow& A, const Weight& W,
+                               WeightGrad& Gw, Eigen::RowVectorXf& Gb, MatrixXfRow* Gx, MatrixXfRow& tile)
+{
+    const Eigen::Index w = std::min<Eigen::Index>(std::max(backward_tile_cols, 1), n);
+    if (tile.rows() != A.rows() || tile.cols() < w) tile.resize(A.rows(), w); // shared by both layers: only ever grows
+    Gw.resize(A.cols(), n);
+    Gb.resize(n);
+    for (Eigen::Index c = 0; c < n; c += w) {
+        const Eigen::Index cw = std::min(w, n - c);
+        auto T = tile.leftCols(cw);
+        tileOf(c, cw, T);
+        Gw.middleCols(c, cw).noalias() = A.transpose() * T;
+        Gb.segment(c, cw) = T.colwise().sum();
+        if (!Gx) continue;
+        if (c == 0)
+            Gx->noalias() = T * W.middleCols(c, cw).transpose();
+        else
+            Gx->noalias() += T * W.middleCols(c, cw).transpose();
+    }
+    if (Gx) *Gx = Gx->array() * (1 - A.array() * A.array());
+}
+
+/**
+ * @brief fusedLayerBackward() for plain SGD: each tile updates its columns of W and b in place
+ * @brief (W -= lr A^T G as the GEMM's own accumulate) instead of being stored in a gradient.
+ * @brief A tile's share of G W^T is taken before that tile of W changes, so dX is unaffected.
+ */
+template <typename TileFn, typename Weight>
+static void fusedLayerUpdate(Eigen::Index n, const TileFn& tileOf, const MatrixXfRow& A, Weight& W,
+                             Eigen::RowVectorXf& b, MatrixXfRow* Gx, MatrixXfRow& tile)
+{
+    const float step = float(lr);
+    const Eigen::Index w = std::min<Eigen::Index>(std::max(backward_tile_cols, 1), n);
+    if (tile.rows() != A.rows() || tile.cols() < w) tile.resize(A.rows(), w);
+    for (Eigen::Index c = 0; c < n; c += w) {
+        const Eigen::Index cw = std::min(w, n - c);
+        auto T = tile.leftCols(cw);
+        tileOf(c, cw, T); // before the update: a recomputed output tile reads these columns of W
+        if (Gx) {
+            if (c == 0)
+                Gx->noalias() = T * W.middleCols(c, cw).transpose();
+            else
+                Gx->noalias() += T * W.middleCols(c, cw).transpose();
+        }
+        W.middleCols(c, cw).noalias() -= step * (A.transpose() * T);
+        b.segment(c, cw) -= step * T.colwise().sum();
+    }
+    if (Gx) *Gx = Gx->array() * (1 - A.array() * A.array());
+}
+
+template <typename Derived>
+static void backUpdateImpl(Weights& weights, Gradients& scratch, const ForwardOutput& forward, const Eigen::MatrixBase<Derived>& X, const SparseBatch* Xs)
+{
+    {
+        PROFILE_SCOPE("backward_update.layer3");
+        auto Gy = [&](Eigen::Index c, Eigen::Index cw, auto& T) { outputGradient(forward, weights, X, c, cw, T); };
+        fusedLayerUpdate(D, Gy, forward.A2, weights.W3, weights.b3, &scratch.Gz2, scratch.tile);
+    }
+    {
+        PROFILE_SCOPE("backward_update.layer2");
+        auto Gz2 = [&](Eigen::Index c, Eigen::Index cw, auto& T) { T = scratch.Gz2.middleCols(c, cw); };
+        fusedLayerUpdate(H_size, Gz2, forward.H, weights.W2, weights.b2, &scratch.Gz, scratch.tile);
+    }
+    PROFILE_SCOPE("backward_update.layer1");
+    weights.b1 -= float(lr) * scratch.Gz.colwise().sum();
+    scratch.Gz *= float(lr); // B x H_size: cheaper to scale than either operand of the W1 product
+    if (Xs)
+        weights.W1.noalias() -= Xs->transpose() * scratch.Gz;
+    else if constexpr (std::is_same<typename Derived::Scalar, float>::value)
+        weights.W1.noalias() -= X.transpose() * scratch.Gz;
+    else
+        inputTiles(X, scratch.tile, [&](Eigen::Index c, Eigen::Index cw, const auto& T) {
+            weights.W1.middleRows(c, cw).noalias() -= T.transpose() * scratch.Gz;
+        });
+}
+
+template <typename Derived>
+static void backImpl(Gradients& gradients, const ForwardOutput& forward, const Weights& weights, const Eigen::MatrixBase<Derived>& X, const SparseBatch* Xs,
+                     const LayerDone& layerDone)
+{
+    if (fused_backward)
+    {
+        {
+            PROFILE_SCOPE("backward.layer3");
+            auto Gy = [&](Eigen::Index c, Eigen::Index cw, auto& T) { outputGradient(forward, weights, X, c, cw, T); };
+            fusedLayerBackward(D, Gy, forward.A2, weights.W3, gradients.Gw3, gradients.Gb3, &gradients.Gz2, gradients.tile);
+        }
+        if (layerDone) layerDone(3);
+        {
+            PROFILE_SCOPE("backward.layer2");
+            auto Gz2 = [&](Eigen::Index c, Eigen::Index cw, auto& T) { T = gradients.Gz2.middleCols(c, cw); };
+            fusedLayerBackward(H_size, Gz2, forward.H, weights.W2, gradients.Gw2, gradients.Gb2, &gradients.Gz, gradients.tile);
+        }
+        if (layerDone) layerDone(2);
+    }
+    else
+    {
+        {
+            PROFILE_SCOPE("backward.loss");
+            gradients.Gy.resize(B, D);
+            outputGradient(forward, weights, X, 0, D, gradients.Gy);
+        }
+        {
+            PROFILE_SCOPE("backward.gemm3");
+            gradients.Gw3 = forward.A2.transpose() * gradients.Gy;
+            gradients.Gb3 = gradients.Gy.colwise().sum();
+            gradients.Ga2 = gradients.Gy * weights.W3.transpose();
+        }
+        if (layerDone) layerDone(3);
+        {
+            PROFILE_SCOPE("backward.tanh2");
+            gradients.Gz2 = gradients.Ga2.array() * (1 - forward.A2.array() * forward.A2.array());
+        }
+        {
+            PROFILE_SCOPE("backward.gemm2");
+            gradients.Gw2 = forward.H.transpose() * gradients.Gz2;
+            gradients.Gb2 = gradients.Gz2.colwise().sum();
+            gradients.Gh = gradients.Gz2 * weights.W2.transpose();
+        }
+        if (layerDone) layerDone(2);
+        {
+            PROFILE_SCOPE("backward.tanh1");
+            gradients.Gz = gradients.Gh.array() * (1 - forward.H.array() * forward.H.array());
+        }
+    }
+    PROFILE_SCOPE("backward.gemm1");
+    if (Xs)
+        gradients.Gw1.noalias() = Xs->transpose() * gradients.Gz; // scatter rows of Gz into the touched rows of Gw1
+    else if constexpr (std::is_same<typename Derived::Scalar, float>::value)
+        gradients.Gw1.noalias() = X.transpose() * gradients.Gz;
+    else {
+        gradients.Gw1.resize(X.cols(), gradients.Gz.cols());
+        inputTiles(X, gradients.tile, [&](Eigen::Index c, Eigen::Index cw, const auto& T) {
+            gradients.Gw1.middleRows(c, cw).noalias() = T.transpose() * gradients.Gz;
+        });
+    }
+    gradients.Gb1 = gradients.Gz.colwise().sum();
+    if (layerDone) layerDone(1);
+}
 
 /**
  * @brief Performs the forward pass through the network.
  * @param forward REFERENCE : Struct containing intermediate results (Z, H, Yhat, sigmoid, loss).
  * @param weights const : Current model weights and biases.
- * @param X const : Input batch matrix of shape (B, D).
+ * @param X const : Input batch matrix of shape (B, D), floats in [0,1] or raw u8 pixels.
+ * @param Xs const : Optional CSR copy of X (values in [0,1]); when given, the first layer runs sparse x dense.
  */
-void forwardPass(ForwardOutput& forward,const Weights& weights, const Eigen::MatrixXf& X)
+void forwardPass(ForwardOutput& forward,const Weights& weights, const MatrixXfRow& X, const SparseBatch* Xs)
 {
-    forward.Z = X * weights.W1;
-    forward.Z.rowwise() += weights.b1;
-    forward.H = forward.Z.array().tanh(); // element wise
-    forward.Z2 = forward.H * weights.W2;
-    forward.Z2.rowwise() += weights.b2;
-    forward.A2 = forward.Z2.array().tanh();
-    forward.Yhat = forward.A2 * weights.W3;
-    forward.Yhat.rowwise() += weights.b3;
-
-    forward.sigmoid = 1.0 / (1.0 + (-forward.Yhat.array()).exp()); // sigmoid element wise
-    Eigen::MatrixXf loss_per_entry = -(X.array() * forward.sigmoid.array().log() // every element compute -xlog(...)
-                                     + (1 - X.array()) * (1 - forward.sigmoid.array()).log());
+    forwardImpl(forward, weights, X, Xs);
+}
 
-    forward.loss = loss_per_entry.mean(); // mean over all entries in batch, mean over B & D !
+void forwardPass(ForwardOutput& forward,const Weights& weights, const MatrixXu8& X, const SparseBatch* Xs)
+{
+    forwardImpl(forward, weights, X, Xs);
 }
 
 /**
@@ -94,21 +387,38 @@ void forwardPass(ForwardOutput& forward,const Weights& weights, const Eigen::Mat
  * @param gradients REF : Output struct to store all computed gradients.
  * @param forward const : Forward pass results.
  * @param weights  const : Current model weights.
- * @param X const : Input batch.
+ * @param X const : Input batch, floats in [0,1] or raw u8 pixels.
+ * @param Xs const : Optional CSR copy of X, used for the W1 gradient.
+ * @param layerDone Optional : called with 3, 2, 1 as the weight and bias gradients of that layer
+ * @brief become final, so they can be shipped (all-reduced) while the earlier layers are computed.
  */
-void backPass(Gradients& gradients, const ForwardOutput& forward, const Weights& weights,const Eigen::MatrixXf& X)
-{
-    gradients.Gy = (forward.sigmoid - X) / (B * D);
-    gradients.Gw3 = forward.A2.transpose() * gradients.Gy;
-    gradients.Gb3 = gradients.Gy.colwise().sum();
-    gradients.Ga2 = gradients.Gy * weights.W3.transpose();
-    gradients.Gz2 = gradients.Ga2.array() * (1 - forward.A2.array() * forward.A2.array());
-    gradients.Gw2 = forward.H.transpose() * gradients.Gz2;
-    gradients.Gb2 = gradients.Gz2.colwise().sum();
-    gradients.Gh = gradients.Gz2 * weights.W2.transpose();
-    gradients.Gz = gradients.Gh.array() * (1 - forward.H.array() * forward.H.array());
-    gradients.Gw1 = X.transpose() * gradients.Gz;
-    gradients.Gb1 = gradients.Gz.colwise().sum();
+void backPass(Gradients& gradients, const ForwardOutput& forward, const Weights& weights,const MatrixXfRow& X, const SparseBatch* Xs,
+              const LayerDone& layerDone)
+{
+    backImpl(gradients, forward, weights, X, Xs, layerDone);
+}
+
+void backPass(Gradients& gradients, const ForwardOutput& forward, const Weights& weights,const MatrixXu8& X, const SparseBatch* Xs,
+              const LayerDone& layerDone)
+{
+    backImpl(gradients, forward, weights, X, Xs, layerDone);
+}
+
+/**
+ * @brief backPass() and backProp() in one sweep, for plain SGD with nothing else needing the
+ * @brief gradient (no accumulation, reduction or clipping): weight gradients are applied tile by
+ * @brief tile as they are produced and never stored. Same update as backPass() + backProp().
+ * @param weights REF : Updated in place; forward must have been computed with these weights.
+ * @param scratch REF : Only its activation-sized buffers are used; Gradients(false) is enough.
+ */
+void backPassUpdate(Weights& weights, Gradients& scratch, const ForwardOutput& forward, const MatrixXfRow& X, const SparseBatch* Xs)
+{
+    backUpdateImpl(weights, scratch, forward, X, Xs);
+}
+
+void backPassUpdate(Weights& weights, Gradients& scratch, const ForwardOutput& forward, const MatrixXu8& X, const SparseBatch* Xs)
+{
+    backUpdateImpl(weights, scratch, forward, X, Xs);
 }
 
 /**
@@ -118,6 +428,7 @@ void backPass(Gradients& gradients, const ForwardOutput& forward, const Weights&
  */
 void backProp(Weights& weights,const Gradients& gradients)
 {
+    PROFILE_SCOPE("update");
     weights.W1 -= lr * gradients.Gw1;
     weights.b1 -= lr * gradients.Gb1;
     weights.W2 -= lr * gradients.Gw2;
@@ -126,6 +437,32 @@ void backProp(Weights& weights,const Gradients& gradients)
     weights.b3 -= lr * gradients.Gb3;
 }
 
+/**
+ * @brief into += g, tensor by tensor (gradient accumulation over micro-batches).
+ */
+void addGradients(Gradients& into, const Gradients& g)
+{
+    into.Gw1 += g.Gw1;
+    into.Gb1 += g.Gb1;
+    into.Gw2 += g.Gw2;
+    into.Gb2 += g.Gb2;
+    into.Gw3 += g.Gw3;
+    into.Gb3 += g.Gb3;
+}
+
+/**
+ * @brief Scales the weight and bias gradients in place (e.g. 1/K after summing K micro-batches).
+ */
+void scaleGradients(Gradients& g, float s)
+{
+    g.Gw1 *= s;
+    g.Gb1 *= s;
+    g.Gw2 *= s;
+    g.Gb2 *= s;
+    g.Gw3 *= s;
+    g.Gb3 *= s;
+}
+
 void training()
 {
 
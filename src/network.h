@@ -2,6 +2,9 @@
 #define NETWORK_H
 
 #include <Eigen/Dense>
+#include <Eigen/Sparse>
+#include <cstdint>
+#include <functional>
 #include <iostream>
 #include <random>
 
@@ -10,44 +13,69 @@ extern int H_size;
 extern int D;
 extern int B;
 extern double lr;
+extern float sparse_density_threshold; // first layer goes sparse below this fraction of nonzero pixels
+extern bool fused_backward;           // layers 3 and 2 backward in one sweep over column tiles of their gradient
+extern int backward_tile_cols;        // gradient columns per tile in the fused backward
+
+// Layout: one sample = one contiguous row, everywhere. Datasets, input batches and every
+// (B, *) activation / gradient are row-major, so batch gathers are row memcpys and the
+// elementwise passes between GEMMs read and write in a single order (no strided copies).
+// Weight gradients share the storage order of the weight they update.
+typedef Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> MatrixXfRow;
+typedef Eigen::SparseMatrix<float, Eigen::RowMajor> SparseBatch; // CSR copy of an input batch
+typedef Eigen::Matrix<uint8_t, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> MatrixXu8; // raw pixels, 0..255
 
 
 
 struct Weights
 {
     // Eigen::MatrixXf W1(256,H); wrong: its not gonna call the constructor
-    Eigen::MatrixXf W1;
+    MatrixXfRow W1;
     Eigen::RowVectorXf b1;
     Eigen::MatrixXf W2;
     Eigen::RowVectorXf b2;
     Eigen::MatrixXf W3;
     Eigen::RowVectorXf b3;
-    Weights();
+    Weights();                        // D inputs, H_size hidden units
+    Weights(int inputs, int hidden);
     void print();
 };
 struct ForwardOutput
 {
-    Eigen::MatrixXf Z;
-    Eigen::MatrixXf H;
-    Eigen::MatrixXf Z2;
-    Eigen::MatrixXf A2;
-    Eigen::MatrixXf Yhat;
-    Eigen::MatrixXf sigmoid; // sigmoid of Y
+    MatrixXfRow H;       // tanh(X W1 + b1); pre-activations are never stored
+    MatrixXfRow A2;      // tanh(H W2 + b2)
+    MatrixXfRow sigmoid; // sigmoid of Y; empty unless keepOutput
+    MatrixXfRow tile;    // output columns being scored, when the output is not kept; u8 input slices
+    bool keepOutput;     // false: the backward recomputes the output from A2, tile by tile
     double loss;
-    ForwardOutput();
+    explicit ForwardOutput(bool keepOutput = true);
     void lossPrint();
 };
 
 struct Gradients
 {
-    Eigen::MatrixXf Gy, Gw3,Ga2,Gz2,Gw2, Gh, Gz, Gw1;
+    MatrixXfRow Gy, Ga2, Gz2, Gh, Gz; // (B, *), like the activations; Gy, Ga2, Gh only without fused_backward
+    Eigen::MatrixXf Gw3, Gw2;          // like W3, W2
+    MatrixXfRow Gw1;                   // like W1
     Eigen::RowVectorXf Gb3,Gb2, Gb1;
-    Gradients();
+    MatrixXfRow tile;                  // (B, backward_tile_cols) slice of a layer's gradient, fused backward, or of u8 X
+    explicit Gradients(bool weightGradients = true); // false: no Gw buffers, for backPassUpdate() only
 };
 
-void forwardPass(ForwardOutput &forward, const Weights &weights, const Eigen::MatrixXf &X);
-void backPass(Gradients &gradients, const ForwardOutput &forward, const Weights &weights, const Eigen::MatrixXf &X);
+void forwardPass(ForwardOutput &forward, const Weights &weights, const MatrixXfRow &X, const SparseBatch *Xs = nullptr);
+void forwardPass(ForwardOutput &forward, const Weights &weights, const MatrixXu8 &X, const SparseBatch *Xs = nullptr);
+typedef std::function<void(int layer)> LayerDone; // backPass() progress: 3, 2, 1 as each layer's gradients are final
+void backPass(Gradients &gradients, const ForwardOutput &forward, const Weights &weights, const MatrixXfRow &X, const SparseBatch *Xs = nullptr,
+              const LayerDone &layerDone = nullptr);
+void backPass(Gradients &gradients, const ForwardOutput &forward, const Weights &weights, const MatrixXu8 &X, const SparseBatch *Xs = nullptr,
+              const LayerDone &layerDone = nullptr);
+void backPassUpdate(Weights &weights, Gradients &scratch, const ForwardOutput &forward, const MatrixXfRow &X, const SparseBatch *Xs = nullptr);
+void backPassUpdate(Weights &weights, Gradients &scratch, const ForwardOutput &forward, const MatrixXu8 &X, const SparseBatch *Xs = nullptr);
+bool useSparseInput(const SparseBatch &Xs);
+size_t activation_bytes(int batch, bool keepOutput); // (batch, *) buffers of one forward + fused backward
 void backProp(Weights &weights, const Gradients &gradients);
+void addGradients(Gradients &into, const Gradients &g);
+void scaleGradients(Gradients &g, float s);
 
 
 #endif // NETWORK_H
\ No newline at end of file
@@ -0,0 +1,208 @@
+#include "profiler.h"
+#include <cstring>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+// ====== SETTINGS ======
+size_t trace_max_events = 1 << 20;
+
+
+// ------------------------------------------------------------
+// Phase registry (one PhaseStats per distinct name, never freed)
+// ------------------------------------------------------------
+static std::mutex g_phases_mtx;
+static std::deque<PhaseStats> g_phases;
+
+PhaseStats *profiler_phase(const char *name)
+{
+    std::lock_guard<std::mutex> lock(g_phases_mtx);
+    for (PhaseStats &p : g_phases)
+        if (std::strcmp(p.name, name) == 0) return &p;
+    g_phases.emplace_back(name);
+    return &g_phases.back();
+}
+
+std::vector<PhaseStats *> profiler_phases()
+{
+    std::lock_guard<std::mutex> lock(g_phases_mtx);
+    std::vector<PhaseStats *> out;
+    for (PhaseStats &p : g_phases) out.push_back(&p);
+    return out;
+}
+
+uint64_t profiler_now_ns()
+{
+    static const auto epoch = std::chrono::steady_clock::now();
+    return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count());
+}
+
+
+// ------------------------------------------------------------
+// Per-thread trace buffers for the Chrome trace (no locking on the hot path)
+// ------------------------------------------------------------
+struct TraceEvent
+{
+    const PhaseStats *phase;
+    uint64_t startNs;
+    uint64_t durNs;
+};
+
+struct ThreadTrace
+{
+    uint32_t tid;
+    std::vector<TraceEvent> events;
+};
+
+static std::mutex g_traces_mtx;
+static std::vector<std::shared_ptr<ThreadTrace>> g_traces;
+
+static ThreadTrace &thread_trace()
+{
+    thread_local std::shared_ptr<ThreadTrace> trace = [] {
+        std::lock_guard<std::mutex> lock(g_traces_mtx);
+        auto t = std::make_shared<ThreadTrace>();
+        t->tid = uint32_t(g_traces.size());
+        g_traces.push_back(t);
+        return t;
+    }();
+    return *trace;
+}
+
+// Buckets [4(e-1), 4e) hold values whose top bit is 2^e; the next two bits pick the quarter.
+static int profile_bucket(uint64_t ns)
+{
+    if (ns < 4) return int(ns);
+    int e = 63 - __builtin_clzll(ns);
+    int bucket = 4 * (e - 1) + int((ns >> (e - 2)) & 3);
+    return bucket < kProfileBuckets ? bucket : kProfileBuckets - 1;
+}
+
+static double profile_bucket_mid_ns(int bucket)
+{
+    if (bucket < 4) return double(bucket);
+    int e = bucket / 4 + 1;
+    int sub = bucket % 4;
+    return (4.0 + sub + 0.5) * double(uint64_t(1) << (e - 2));
+}
+
+void profiler_record(PhaseStats *phase, uint64_t startNs, uint64_t endNs)
+{
+    const uint64_t ns = endNs - startNs;
+    phase->count.fetch_add(1, std::memory_order_relaxed);
+    phase->totalNs.fetch_add(ns, std::memory_order_relaxed);
+    uint64_t prevMax = phase->maxNs.load(std::memory_order_relaxed);
+    while (ns > prevMax && !phase->maxNs.compare_exchange_weak(prevMax, ns, std::memory_order_relaxed)) {
+    }
+    phase->hist[profile_bucket(ns)].fetch_add(1, std::memory_order_relaxed);
+
+    ThreadTrace &trace = thread_trace();
+    if (trace.events.size() < trace_max_events) trace.events.push_back({phase, startNs, ns});
+}
+
+/**
+ * @brief Write every recorded event as a Chrome trace (chrome://tracing, Perfetto).
+ * @brief Call once the worker threads are idle.
+ */
+bool profiler_write_chrome_trace(const std::string &path)
+{
+    std::ofstream f(path);
+    if (!f) {
+        std::cerr << "ERROR: cannot write trace " << path << "\n";
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(g_traces_mtx);
+    f << "{\"traceEvents\":[\n";
+    f << std::fixed << std::setprecision(3);
+    bool first = true;
+    for (const auto &t : g_traces) {
+        for (const TraceEvent &e : t->events) {
+            f << (first ? "" : ",\n") << "{\"name\":\"" << e.phase->name << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << t->tid
+              << ",\"ts\":" << e.startNs / 1000.0 << ",\"dur\":" << e.durNs / 1000.0 << "}";
+            first = false;
+        }
+    }
+    f << "\n]}\n";
+    return bool(f);
+}
+
+
+// ------------------------------------------------------------
+// MetricsSink
+// ------------------------------------------------------------
+MetricsSink::MetricsSink(const std::string &csvPath, const std::string &jsonlPath) : last(std::chrono::steady_clock::now())
+{
+    if (!csvPath.empty()) {
+        csv.open(csvPath);
+        if (!csv) std::cerr << "ERROR: cannot write metrics " << csvPath << "\n";
+        csv << "iteration,metric,value\n"; // long format: one row per metric per interval
+    }
+    if (!jsonlPath.empty()) {
+        jsonl.open(jsonlPath);
+        if (!jsonl) std::cerr << "ERROR: cannot write metrics " << jsonlPath << "\n";
+    }
+}
+
+// Approximate percentile from the histogram (middle of the bucket), in us.
+static double hist_percentile(const uint64_t *hist, uint64_t count, double q)
+{
+    const uint64_t target = uint64_t(q * double(count));
+    uint64_t seen = 0;
+    for (int i = 0; i < kProfileBuckets; ++i) {
+        seen += hist[i];
+        if (seen > target) return profile_bucket_mid_ns(i) / 1000.0;
+    }
+    return 0.0;
+}
+
+void MetricsSink::flush(size_t iteration, const std::vector<std::pair<std::string, double>> &scalars)
+{
+    const auto now = std::chrono::steady_clock::now();
+    const double interval = std::chrono::duration<double>(now - last).count();
+    last = now;
+
+    std::vector<std::pair<std::string, double>> rows(scalars);
+    rows.emplace_back("interval_s", interval);
+    if (csv.is_open())
+        for (const auto &s : rows) csv << iteration << "," << s.first << "," << s.second << "\n";
+    if (jsonl.is_open()) {
+        jsonl << "{\"iteration\":" << iteration;
+        for (const auto &s : rows) jsonl << ",\"" << s.first << "\":" << s.second;
+        jsonl << ",\"phases\":{";
+    }
+
+    bool first = true;
+    for (PhaseStats *p : profiler_phases()) {
+        // take-and-reset so every flush reports only its own interval
+        const uint64_t count = p->count.exchange(0, std::memory_order_relaxed);
+        const uint64_t total = p->totalNs.exchange(0, std::memory_order_relaxed);
+        const uint64_t maxNs = p->maxNs.exchange(0, std::memory_order_relaxed);
+        uint64_t hist[kProfileBuckets];
+        for (int i = 0; i < kProfileBuckets; ++i) hist[i] = p->hist[i].exchange(0, std::memory_order_relaxed);
+        if (count == 0) continue;
+
+        const std::pair<const char *, double> stats[] = {
+            {"count", double(count)},
+            {"total_ms", total / 1e6},
+            {"mean_us", total / 1e3 / double(count)},
+            {"p50_us", hist_percentile(hist, count, 0.50)},
+            {"p90_us", hist_percentile(hist, count, 0.90)},
+            {"p99_us", hist_percentile(hist, count, 0.99)},
+            {"max_us", maxNs / 1e3},
+        };
+        if (csv.is_open())
+            for (const auto &s : stats) csv << iteration << "," << p->name << "." << s.first << "," << s.second << "\n";
+        if (jsonl.is_open()) {
+            jsonl << (first ? "" : ",") << "\"" << p->name << "\":{";
+            for (size_t i = 0; i < sizeof(stats) / sizeof(stats[0]); ++i)
+                jsonl << (i ? "," : "") << "\"" << stats[i].first << "\":" << stats[i].second;
+            jsonl << "}";
+        }
+        first = false;
+    }
+    if (jsonl.is_open()) jsonl << "}}\n" << std::flush;
+    if (csv.is_open()) csv << std::flush;
+}
@@ -0,0 +1,79 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+// ====== Hot-path phase timers ======
+// PROFILE_SCOPE("forward.gemm1") times the enclosing block. Timers only exist when the
+// tree is built with -DVAE_PROFILE (make PROFILE=1); otherwise the macro expands to nothing.
+
+// Log-linear histogram of ns: 4 buckets per power of two, up to ~2^40 ns.
+constexpr int kProfileBuckets = 160;
+
+struct PhaseStats
+{
+    const char *name;
+    std::atomic<uint64_t> count{0};
+    std::atomic<uint64_t> totalNs{0};
+    std::atomic<uint64_t> maxNs{0};
+    std::atomic<uint64_t> hist[kProfileBuckets] = {};
+    explicit PhaseStats(const char *name) : name(name) {}
+};
+
+extern size_t trace_max_events; // per thread; Chrome-trace events past this are not recorded
+
+PhaseStats *profiler_phase(const char *name);
+std::vector<PhaseStats *> profiler_phases();
+uint64_t profiler_now_ns();
+void profiler_record(PhaseStats *phase, uint64_t startNs, uint64_t endNs);
+bool profiler_write_chrome_trace(const std::string &path);
+
+class ScopedTimer
+{
+public:
+    explicit ScopedTimer(PhaseStats *phase) : phase(phase), start(profiler_now_ns()) {}
+    ~ScopedTimer() { profiler_record(phase, start, profiler_now_ns()); }
+    ScopedTimer(const ScopedTimer &) = delete;
+    ScopedTimer &operator=(const ScopedTimer &) = delete;
+
+private:
+    PhaseStats *phase;
+    uint64_t start;
+};
+
+#define PROFILE_CONCAT2(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT2(a, b)
+#ifdef VAE_PROFILE
+#define PROFILE_SCOPE(name)                                                                 \
+    static PhaseStats *const PROFILE_CONCAT(profile_phase_, __LINE__) = profiler_phase(name); \
+    ScopedTimer PROFILE_CONCAT(profile_timer_, __LINE__)(PROFILE_CONCAT(profile_phase_, __LINE__))
+#else
+#define PROFILE_SCOPE(name) ((void)0)
+#endif
+
+
+// ====== Training telemetry ======
+/**
+ * @brief Interval metrics writer. Each flush() writes the scalars passed in (loss, ...) and,
+ * @brief when profiling is compiled in, per-phase count/mean/p50/p90/p99/max for the interval,
+ * @brief then resets the phase counters. An empty path disables that output.
+ */
+class MetricsSink
+{
+public:
+    MetricsSink(const std::string &csvPath, const std::string &jsonlPath);
+    void flush(size_t iteration, const std::vector<std::pair<std::string, double>> &scalars);
+
+private:
+    std::ofstream csv;
+    std::ofstream jsonl;
+    std::chrono::steady_clock::time_point last;
+};
+
+#endif // PROFILER_H
@@ -0,0 +1,115 @@
+#include "prune.h"
+#include "eval.h"
+#include "shape.h"
+#include <algorithm>
+#include <numeric>
+#include <vector>
+
+// ====== SETTINGS ======
+size_t prune_stats_images = 10000;
+
+void UnitStats::add(const ForwardOutput &forward)
+{
+    if (count == 0) {
+        sum1.setZero(forward.H.cols());
+        sumSq1.setZero(forward.H.cols());
+        sum2.setZero(forward.A2.cols());
+        sumSq2.setZero(forward.A2.cols());
+    }
+    sum1 += forward.H.colwise().sum().cast<double>();
+    sumSq1 += forward.H.array().square().matrix().colwise().sum().cast<double>();
+    sum2 += forward.A2.colwise().sum().cast<double>();
+    sumSq2 += forward.A2.array().square().matrix().colwise().sum().cast<double>();
+    count += size_t(forward.H.rows());
+}
+
+Eigen::RowVectorXf UnitStats::mean(int layer) const
+{
+    return ((layer == 1 ? sum1 : sum2) / double(std::max<size_t>(count, 1))).cast<float>();
+}
+
+Eigen::RowVectorXf UnitStats::stddev(int layer) const
+{
+    const double n = double(std::max<size_t>(count, 1));
+    const Eigen::RowVectorXd m = (layer == 1 ? sum1 : sum2) / n;
+    return ((layer == 1 ? sumSq1 : sumSq2) / n - m.cwiseProduct(m)).cwiseMax(0.0).cwiseSqrt().cast<float>();
+}
+
+/**
+ * @brief Hidden-unit statistics over the first `images` training images, eval_batch rows per
+ * @brief block in parallel; blocks are merged in order, so the result does not depend on threads.
+ */
+UnitStats gather_unit_stats(const Weights &weights, size_t images, ThreadPool &pool)
+{
+    const Dataset &data = dataset(true);
+    const long rows = long(std::min(images, data.size()));
+    const long grain = std::max(1, eval_batch);
+    std::vector<UnitStats> blocks(size_t((rows + grain - 1) / grain));
+    pool.parallelForRows(rows, grain, [&](long begin, long end) {
+        MatrixXu8 X;
+        data.read(size_t(begin), size_t(end - begin), X);
+        ForwardOutput forward(false); // the hidden layers are all that is needed
+        forwardPass(forward, weights, X);
+        blocks[size_t(begin / grain)].add(forward);
+    });
+    UnitStats stats;
+    for (const UnitStats &b : blocks) {
+        if (b.count == 0) continue;
+        if (stats.count == 0) {
+            stats = b;
+            continue;
+        }
+        stats.sum1 += b.sum1;
+        stats.sumSq1 += b.sumSq1;
+        stats.sum2 += b.sum2;
+        stats.sumSq2 += b.sumSq2;
+        stats.count += b.count;
+    }
+    return stats;
+}
+
+/**
+ * @brief Saliency of every unit of hidden layer 1 (H) or 2 (A2); higher is more important.
+ */
+Eigen::RowVectorXf unit_scores(const Weights &weights, const UnitStats &stats, int layer, PruneCriterion criterion)
+{
+    const Eigen::RowVectorXf out = layer == 1 ? weights.W2.rowwise().norm().transpose() : weights.W3.rowwise().norm().transpose();
+    if (criterion == PruneCriterion::Activation && stats.count > 0) return stats.stddev(layer).cwiseProduct(out);
+    const Eigen::RowVectorXf in = layer == 1 ? Eigen::RowVectorXf(weights.W1.colwise().norm()) : Eigen::RowVectorXf(weights.W2.colwise().norm());
+    return in.cwiseProduct(out);
+}
+
+static std::vector<int> best_units(const Eigen::RowVectorXf &score, int keep) // in their original order
+{
+    std::vector<int> order(size_t(score.size()));
+    std::iota(order.begin(), order.end(), 0);
+    keep = std::clamp(keep, 1, int(order.size()));
+    std::partial_sort(order.begin(), order.begin() + keep, order.end(), [&](int a, int b) { return score(a) > score(b); });
+    order.resize(size_t(keep));
+    std::sort(order.begin(), order.end());
+    return order;
+}
+
+Weights prune_units(const Weights &weights, const UnitStats &stats, int keep1, int keep2, PruneCriterion criterion)
+{
+    const std::vector<int> k1 = best_units(unit_scores(weights, stats, 1, criterion), keep1);
+    const std::vector<int> k2 = best_units(unit_scores(weights, stats, 2, criterion), keep2);
+
+    Eigen::RowVectorXf b2 = weights.b2, b3 = weights.b3;
+    if (stats.count > 0) { // a removed unit still contributes its mean output: move it into the bias
+        Eigen::RowVectorXf dropped1 = stats.mean(1), dropped2 = stats.mean(2);
+        for (int j : k1) dropped1(j) = 0.0f;
+        for (int k : k2) dropped2(k) = 0.0f;
+        b2.noalias() += dropped1 * weights.W2;
+        b3.noalias() += dropped2 * weights.W3;
+    }
+
+    Weights out = weights;
+    out.W1 = weights.W1(Eigen::all, k1);
+    out.b1 = weights.b1(k1);
+    out.W2 = weights.W2(k1, k2);
+    out.b2 = b2(k2);
+    out.W3 = weights.W3(k2, Eigen::all);
+    out.b3 = b3;
+    return out;
+}
@@ -0,0 +1,42 @@
+#ifndef PRUNE_H
+#define PRUNE_H
+
+#include "network.h"
+#include "thread_pool.h"
+
+// ====== SETTINGS ======
+extern size_t prune_stats_images; // training images gather_unit_stats() runs through
+
+// How hidden units are ranked for removal.
+//   Magnitude  : |incoming weights| * |outgoing weights|
+//   Activation : stddev of the unit's tanh output * |outgoing weights|, i.e. how much the unit
+//                moves the next layer; the constant part of every removed unit is kept (folded
+//                into the next bias), so a saturated or dead unit costs nothing to remove.
+enum class PruneCriterion { Magnitude, Activation };
+
+/**
+ * @brief Running mean and variance of every hidden unit's output, both layers, over any forward
+ * @brief passes (training batches, an evaluation sweep). Sums are in double.
+ */
+struct UnitStats
+{
+    Eigen::RowVectorXd sum1, sumSq1, sum2, sumSq2; // H, then A2
+    size_t count = 0;
+
+    void add(const ForwardOutput &forward);
+    Eigen::RowVectorXf mean(int layer) const;   // layer 1 (H) or 2 (A2)
+    Eigen::RowVectorXf stddev(int layer) const;
+};
+
+UnitStats gather_unit_stats(const Weights &weights, size_t images = prune_stats_images, ThreadPool &pool = global_pool());
+Eigen::RowVectorXf unit_scores(const Weights &weights, const UnitStats &stats, int layer, PruneCriterion criterion);
+
+/**
+ * @brief Structured pruning: keep the keep1 best units of the first hidden layer and the keep2
+ * @brief best of the second, and compact the weights into smaller dense matrices
+ * @brief (D x keep1, keep1 x keep2, keep2 x D) that forwardPass and the checkpoint format take as is.
+ * @brief With stats, the mean output of each removed unit is folded into the next layer's bias.
+ */
+Weights prune_units(const Weights &weights, const UnitStats &stats, int keep1, int keep2, PruneCriterion criterion);
+
+#endif // PRUNE_H
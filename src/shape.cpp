@@ -1,150 +1,148 @@
 #include "shape.h"
-#include <fstream>
-#include <vector>
+#include "augment.h"
+#include "image_io.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
-#include <cassert>
-#include <cmath>
+#include <mutex>
 
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #include "/Users/daboi/Documents/Projects/VAE/Intelligent_Data_Compression_Framework/third_party/stb/stb_image_write.h"
 
 
+// ====== SETTINGS ======
+std::string train_data = "/Users/daboi/Documents/Projects/VAE/Intelligent_Data_Compression_Framework/MNIST/train-images.idx3-ubyte";
+std::string test_data  = "/Users/daboi/Documents/Projects/VAE/Intelligent_Data_Compression_Framework/MNIST/t10k-images.idx3-ubyte";
+ImageShape image_shape;
+
+
 // ------------------------------------------------------------
-// Global MNIST storage (lazy-loaded)
+// Global datasets (lazy-loaded), raw bytes: 4x smaller than floats
 // ------------------------------------------------------------
-static Eigen::MatrixXf g_train_images;
-static Eigen::MatrixXf g_test_images;
-static bool g_loaded = false;
+static std::unique_ptr<Dataset> g_split[2]; // test, train
+static std::once_flag g_opened[2];          // batches may be drawn from several threads
+static std::mutex g_shapeMtx;
+static bool g_shapeSet = false;
 
 
 // ------------------------------------------------------------
-// Helper: read big-endian 32-bit int
+// Open one split once; the first split's image size becomes D
 // ------------------------------------------------------------
-static uint32_t read_uint32(std::ifstream &f)
+static Dataset &open_split(bool use_train)
 {
-    unsigned char b[4];
-    f.read((char*)b, 4);
-    return (uint32_t(b[0]) << 24) |
-           (uint32_t(b[1]) << 16) |
-           (uint32_t(b[2]) << 8 ) |
-            uint32_t(b[3]);
+    std::call_once(g_opened[use_train], [use_train] {
+        const char *name = use_train ? "train" : "test";
+        std::cout << "Loading " << name << " images...\n";
+        std::unique_ptr<Dataset> data = open_dataset(use_train ? train_data : test_data);
+        if (!data) exit(1);
+        {
+            std::lock_guard<std::mutex> lock(g_shapeMtx);
+            if (!g_shapeSet) {
+                image_shape = data->shape();
+                D = image_shape.dim();
+                g_shapeSet = true;
+            } else if (data->shape() != image_shape) {
+                std::cerr << "ERROR: train and test images differ in shape\n";
+                exit(1);
+            }
+        }
+        std::cout << "Loaded " << data->size() << " " << name << " images of " << image_shape.width << "x" << image_shape.height << "x"
+                  << image_shape.channels << ".\n";
+        g_split[use_train] = std::move(data);
+    });
+    return *g_split[use_train];
 }
 
-// ------------------------------------------------------------
-// Load MNIST IDX3 image file
-// ------------------------------------------------------------
-static Eigen::MatrixXf load_idx3_images(const std::string &path)
+void load_datasets(bool use_train)
 {
-    std::ifstream f(path, std::ios::binary);
-    if (!f) {
-        std::cerr << "ERROR: cannot open MNIST file: " << path << "\n";
-        exit(1);
-    }
-
-    uint32_t magic   = read_uint32(f);
-    uint32_t n_images= read_uint32(f);
-    uint32_t n_rows  = read_uint32(f);
-    uint32_t n_cols  = read_uint32(f);
-
-    assert(magic == 2051); // Magic number for MNIST images
-    assert(n_rows == 28 && n_cols == 28);
+    open_split(use_train);
+}
 
-    Eigen::MatrixXf X(n_images, 28*28);
+Dataset &dataset(bool use_train)
+{
+    return open_split(use_train);
+}
 
-    std::vector<unsigned char> buffer(28*28);
+const char *const dataset_flags_usage = " [--train SPEC] [--test SPEC] [--raw WxHxC] [--cache DIR]";
 
-    for (uint32_t i = 0; i < n_images; ++i) {
-        f.read((char*)buffer.data(), 28*28);
-        for (int j = 0; j < 28*28; ++j) {
-            X(i, j) = float(buffer[j]) / 255.0f; // normalize
+bool parse_dataset_flag(int argc, char **argv, int &i)
+{
+    auto next = [&]() { return (i + 1 < argc) ? argv[++i] : (std::cerr << "missing value for " << argv[i] << "\n", std::exit(2), nullptr); };
+    if (!std::strcmp(argv[i], "--train")) train_data = next();
+    else if (!std::strcmp(argv[i], "--test")) test_data = next();
+    else if (!std::strcmp(argv[i], "--cache")) dataset_cache = next();
+    else if (!std::strcmp(argv[i], "--raw")) {
+        if (std::sscanf(next(), "%dx%dx%d", &raw_shape.width, &raw_shape.height, &raw_shape.channels) != 3) {
+            std::cerr << "--raw takes WxHxC, e.g. 28x28x1\n";
+            std::exit(2);
         }
     }
-    return X;
+    else return false;
+    return true;
 }
 
 
 // ------------------------------------------------------------
-// Load MNIST dataset once
+// Public: sample a batch of raw images (0..255)
+// Training batches are augmented on the way (augment.h), when any
+// augment_* setting is on; test batches never are.
+// If sparse is given, it receives the CSR form of the same rows,
+// normalised to [0,1] (most MNIST pixels are exactly 0), for the
+// sparse first layer.
 // ------------------------------------------------------------
-static void load_mnist()
+MatrixXu8 make_batch_u8(int batch_size,
+                        std::mt19937 &rng,
+                        bool use_train,
+                        SparseBatch *sparse)
 {
-    if (g_loaded) return;
-
-    std::cout << "Loading MNIST...\n";
-
-    g_train_images = load_idx3_images("/Users/daboi/Documents/Projects/VAE/Intelligent_Data_Compression_Framework/MNIST/train-images.idx3-ubyte");
-    g_test_images  = load_idx3_images("/Users/daboi/Documents/Projects/VAE/Intelligent_Data_Compression_Framework/MNIST/t10k-images.idx3-ubyte");
-
-    g_loaded = true;
-
-    std::cout << "MNIST loaded: "
-              << g_train_images.rows() << " train, "
-              << g_test_images.rows() << " test images.\n";
+    MatrixXu8 X;
+    dataset(use_train).sample(batch_size, rng, X);
+    if (use_train && augment_enabled()) {
+        const uint64_t seed = (uint64_t(rng()) << 32) | rng(); // the batch's stream decides, not the threads
+        augment_batch(X, image_shape, seed);
+    }
+    const int d = int(X.cols());
+
+    if (sparse) {
+        sparse->resize(batch_size, d);
+        sparse->reserve(Eigen::Index(batch_size) * d / 4);
+        for (int i = 0; i < batch_size; ++i) {
+            sparse->startVec(i);
+            for (int j = 0; j < d; ++j) {
+                uint8_t v = X(i, j);
+                if (v != 0) sparse->insertBack(i, j) = float(v) / 255.0f;
+            }
+        }
+        sparse->finalize();
+    }
+    return X;
 }
 
-
 // ------------------------------------------------------------
-// Public: sample a batch of MNIST images
+// Public: same batch as floats in [0,1] (snapshots, tools)
 // ------------------------------------------------------------
-Eigen::MatrixXf make_batch_mnist(int batch_size,
-                                 std::mt19937 &rng,
-                                 bool use_train)
+MatrixXfRow make_batch(int batch_size,
+                       std::mt19937 &rng,
+                       bool use_train,
+                       SparseBatch *sparse)
 {
-    load_mnist();
-
-    const Eigen::MatrixXf &Xsrc = use_train ? g_train_images : g_test_images;
-
-    std::uniform_int_distribution<int> U(0, Xsrc.rows() - 1);
-
-    Eigen::MatrixXf X(batch_size, 28*28);
-
-    for (int i = 0; i < batch_size; ++i) {
-        int idx = U(rng);
-        X.row(i) = Xsrc.row(idx);
-    }
-    return X;
+    return make_batch_u8(batch_size, rng, use_train, sparse).cast<float>() / 255.0f;
 }
 
 
 // ------------------------------------------------------------
-// Save MNIST images in a grid (like your shapes saver)
+// Save images in a grid, tiles shaped like the training images
 // ------------------------------------------------------------
-bool write_png_grid_mnist(const Eigen::MatrixXf &batch,
-                          int gridCols,
-                          int gridRows,
-                          const std::string &outPath)
+bool write_png_grid(const MatrixXfRow &batch,
+                    int gridCols,
+                    int gridRows,
+                    const std::string &outPath,
+                    const ImageWriteOptions &opts)
 {
-    const int B = batch.rows();
-    const int W = 28, H = 28;
-
-    const int outW = gridCols * W;
-    const int outH = gridRows * H;
-
-    std::vector<unsigned char> img(outW * outH);
+    std::vector<unsigned char> img;
+    pack_tiles_u8(batch, image_shape, gridCols, gridRows, img);
 
-    auto putTile = [&](int b, int gx, int gy) {
-        for (int y = 0; y < H; ++y) {
-            for (int x = 0; x < W; ++x) {
-
-                float v = batch(b, y * W + x);
-                unsigned char u8 = (unsigned char)(std::round(std::clamp(v, 0.0f, 1.0f) * 255.0f));
-
-                int outX = gx * W + x;
-                int outY = gy * H + y;
-
-                img[outY * outW + outX] = u8;
-            }
-        }
-    };
-
-    int b = 0;
-    for (int gy = 0; gy < gridRows; ++gy) {
-        for (int gx = 0; gx < gridCols; ++gx) {
-            if (b < B)
-                putTile(b++, gx, gy);
-        }
-    }
-
-    int ok = stbi_write_png(outPath.c_str(), outW, outH, 1, img.data(), outW);
-    return ok != 0;
-}
\ No newline at end of file
+    return write_image(outPath, img.data(), gridCols * image_shape.width, gridRows * image_shape.height,
+                       image_shape.channels, opts);
+}
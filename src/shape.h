@@ -1,11 +1,39 @@
+#pragma once
 #include <Eigen/Dense>
 #include <random>
+#include "dataset.h"
+#include "image_io.h"
+#include "network.h" // MatrixXu8, SparseBatch
+#include <string>
 
-Eigen::MatrixXf make_batch_mnist(int batch_size,
-                                 std::mt19937 &rng,
-                                 bool use_train);
+// ====== SETTINGS ======
+extern std::string train_data; // dataset specs, see open_dataset()
+extern std::string test_data;
+extern ImageShape image_shape; // shape of the training images; set, with D, by load_datasets()
 
-bool write_png_grid_mnist(const Eigen::MatrixXf &batch,
-                          int gridCols,
-                          int gridRows,
-                          const std::string &outPath);
\ No newline at end of file
+// Each split is opened on its first use, once; the first one opened sets image_shape and D, and
+// the other must match it. Call load_datasets() for the split a tool needs before sizing
+// anything from D; dataset() opens the other one if and when it is used.
+void load_datasets(bool use_train = true);
+Dataset &dataset(bool use_train);
+
+// The dataset flags every tool takes: --train SPEC, --test SPEC, --raw WxHxC, --cache DIR.
+// If argv[i] is one of them, consumes it and its value (i moves on) and returns true.
+bool parse_dataset_flag(int argc, char **argv, int &i);
+extern const char *const dataset_flags_usage; // " [--train SPEC] [--test SPEC] [--raw WxHxC] [--cache DIR]"
+
+MatrixXu8 make_batch_u8(int batch_size,
+                        std::mt19937 &rng,
+                        bool use_train,
+                        SparseBatch *sparse = nullptr);
+
+MatrixXfRow make_batch(int batch_size,
+                       std::mt19937 &rng,
+                       bool use_train,
+                       SparseBatch *sparse = nullptr);
+
+bool write_png_grid(const MatrixXfRow &batch,
+                    int gridCols,
+                    int gridRows,
+                    const std::string &outPath,
+                    const ImageWriteOptions &opts = ImageWriteOptions());
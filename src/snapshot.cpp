@@ -0,0 +1,94 @@
+#include "snapshot.h"
+#include "shape.h"
+#include "profiler.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <iostream>
+
+SnapshotWriter::SnapshotWriter(size_t depth) : SnapshotWriter(global_pool(), depth) {}
+
+SnapshotWriter::SnapshotWriter(ThreadPool &pool, size_t depth) : pool(pool), slots(std::max<size_t>(depth, 1)) {}
+
+/**
+ * @brief Waits for every snapshot still queued; the pool must outlive the writer.
+ */
+SnapshotWriter::~SnapshotWriter()
+{
+    flush();
+}
+
+/**
+ * @brief Queue a grid for writing. Never waits on the disk or on the encoder.
+ * @param batch const : (B, D) images in [0,1]; only gridCols*gridRows rows are copied.
+ * @return false if every slot is busy and the snapshot was dropped.
+ */
+bool SnapshotWriter::submit(const MatrixXfRow &batch, int gridCols, int gridRows, const std::string &outPath)
+{
+    std::unique_lock<std::mutex> lock(mtx);
+    auto free = std::find_if(slots.begin(), slots.end(), [](const Slot &s) { return !s.busy; });
+    if (free == slots.end()) {
+        ++droppedCount;
+        return false;
+    }
+    Slot &slot = *free;
+    slot.busy = true;
+    ++inFlight;
+    lock.unlock();
+
+    // Nothing else touches a busy slot until its task runs, so the copy can run unlocked.
+    const Eigen::Index n = std::min<Eigen::Index>(batch.rows(), Eigen::Index(gridCols) * gridRows);
+    slot.tiles = batch.topRows(n); // reuses the slot's storage once it has the right size
+    slot.gridCols = gridCols;
+    slot.gridRows = gridRows;
+    slot.path = outPath;
+
+    pool.submit([this, &slot] { write(slot); });
+    return true;
+}
+
+/**
+ * @brief Like submit(), but sleeps until a write frees a slot instead of dropping the grid.
+ * @brief For offline producers such as the generator, where every grid must reach the disk.
+ */
+bool SnapshotWriter::submitBlocking(const MatrixXfRow &batch, int gridCols, int gridRows, const std::string &outPath)
+{
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        slotFreed.wait(lock, [this] { return inFlight < slots.size(); });
+    } // single producer: the slot is still free when submit() looks
+    return submit(batch, gridCols, gridRows, outPath);
+}
+
+/**
+ * @brief Sleep until every queued snapshot has been written.
+ */
+void SnapshotWriter::flush()
+{
+    std::unique_lock<std::mutex> lock(mtx);
+    slotFreed.wait(lock, [this] { return inFlight == 0; });
+}
+
+size_t SnapshotWriter::dropped() const
+{
+    std::lock_guard<std::mutex> lock(mtx);
+    return droppedCount;
+}
+
+void SnapshotWriter::write(Slot &slot)
+{
+    bool ok;
+    {
+        PROFILE_SCOPE("snapshot.write");
+        ok = write_png_grid(slot.tiles, slot.gridCols, slot.gridRows, slot.path);
+    }
+    if (!ok) {
+        std::cerr << " Failed to write " << slot.path << "\n";
+    } else {
+        std::cout << "Saved " << slot.path << "\n";
+    }
+
+    std::lock_guard<std::mutex> lock(mtx);
+    slot.busy = false;
+    --inFlight;
+    slotFreed.notify_all(); // under the lock: once flush() sees 0 the writer may be destroyed
+}
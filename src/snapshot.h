@@ -0,0 +1,56 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <Eigen/Dense>
+#include "network.h" // MatrixXfRow
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class ThreadPool;
+
+/**
+ * @brief Background PNG writer for reconstruction snapshots.
+ * @brief submit() copies the tiles into one of a fixed set of slots and returns; the PNG
+ * @brief encoding and the disk write run as a task on the shared pool. When every slot is
+ * @brief busy the snapshot is dropped (and counted) instead of blocking training.
+ * @brief Single producer: submit() is only called from the training thread.
+ */
+class SnapshotWriter
+{
+public:
+    explicit SnapshotWriter(size_t depth = 4);
+    SnapshotWriter(ThreadPool &pool, size_t depth);
+    ~SnapshotWriter();
+
+    SnapshotWriter(const SnapshotWriter &) = delete;
+    SnapshotWriter &operator=(const SnapshotWriter &) = delete;
+
+    bool submit(const MatrixXfRow &batch, int gridCols, int gridRows, const std::string &outPath);
+    bool submitBlocking(const MatrixXfRow &batch, int gridCols, int gridRows, const std::string &outPath);
+    void flush();
+    size_t dropped() const;
+
+private:
+    struct Slot
+    {
+        MatrixXfRow tiles; // only the rows that fit in the grid
+        int gridCols = 0;
+        int gridRows = 0;
+        std::string path;
+        bool busy = false; // queued or being written
+    };
+
+    void write(Slot &slot);
+
+    ThreadPool &pool;
+    std::vector<Slot> slots;
+    size_t inFlight = 0;
+    size_t droppedCount = 0;
+
+    mutable std::mutex mtx;
+    std::condition_variable slotFreed; // a write finished: submitBlocking() and flush() re-check
+};
+
+#endif // SNAPSHOT_H
@@ -0,0 +1,237 @@
+#include "thread_pool.h"
+#include <Eigen/Core>
+#include <algorithm>
+#include <iostream>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+// ====== SETTINGS ======
+int pool_threads = 0;
+Affinity pool_affinity = Affinity::None;
+
+// Index of the pool queue owned by the current thread, -1 outside the pool.
+static thread_local const ThreadPool *t_pool = nullptr;
+static thread_local int t_index = -1;
+
+// ------------------------------------------------------------
+// Affinity helpers (Linux only; elsewhere pinning is a no-op)
+// ------------------------------------------------------------
+static std::vector<int> allowed_cpus()
+{
+    std::vector<int> cpus;
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0)
+        for (int c = 0; c < CPU_SETSIZE; ++c)
+            if (CPU_ISSET(c, &set)) cpus.push_back(c);
+#endif
+    return cpus;
+}
+
+static void pin_to_cpu(int cpu)
+{
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0)
+        std::cerr << "WARNING: could not pin worker to cpu " << cpu << "\n";
+#else
+    (void)cpu;
+#endif
+}
+
+
+// ------------------------------------------------------------
+// Pool
+// ------------------------------------------------------------
+ThreadPool::ThreadPool(int threads, Affinity affinity)
+{
+    if (threads <= 0) threads = std::max(1, int(std::thread::hardware_concurrency()) - 1);
+
+    // The pool owns the cores: keep Eigen's own (OpenMP) GEMM threading out of the way.
+    Eigen::setNbThreads(1);
+
+    std::vector<int> cpus = affinity == Affinity::None ? std::vector<int>() : allowed_cpus();
+    for (int i = 0; i < threads; ++i) queues.push_back(std::make_unique<Queue>());
+    for (int i = 0; i < threads; ++i) {
+        int cpu = -1;
+        if (!cpus.empty()) {
+            const size_t n = cpus.size();
+            cpu = affinity == Affinity::Compact ? cpus[size_t(i) % n] : cpus[(size_t(i) * n / size_t(threads)) % n];
+        }
+        workers.emplace_back(&ThreadPool::run, this, i, cpu);
+    }
+    jobThread = std::thread(&ThreadPool::runJobs, this);
+}
+
+/**
+ * @brief Runs whatever is still queued, then joins the workers.
+ */
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(sleepMtx);
+        stopping = true;
+    }
+    taskReady.notify_all();
+    for (auto &w : workers) w.join();
+    jobThread.join();
+}
+
+void ThreadPool::enqueue(Task task)
+{
+    // A worker keeps what it spawns (good locality); outside threads deal round-robin.
+    const int q = (t_pool == this) ? t_index : int(nextQueue++ % queues.size());
+    {
+        std::lock_guard<std::mutex> lock(queues[q]->mtx);
+        queues[q]->tasks.push_back(std::move(task));
+    }
+    pending.fetch_add(1);
+    {
+        std::lock_guard<std::mutex> lock(sleepMtx); // pairs with the predicate check in run()
+    }
+    taskReady.notify_one();
+}
+
+void ThreadPool::enqueueJob(std::function<void()> job)
+{
+    {
+        std::lock_guard<std::mutex> lock(jobs.mtx);
+        jobs.tasks.push_back({std::move(job), nullptr});
+    }
+    pendingJobs.fetch_add(1);
+    {
+        std::lock_guard<std::mutex> lock(sleepMtx);
+    }
+    taskReady.notify_all(); // the job thread must hear it even if a worker would too
+}
+
+/**
+ * @brief Pop from our own queue's back, else steal from the front of another one. With a loop,
+ * @brief only that parallelFor's pieces are taken (oldest first, wherever they were queued).
+ * @return false if there was nothing to take.
+ */
+bool ThreadPool::tryRunOne(int self, const void *loop)
+{
+    const int n = int(queues.size());
+    std::function<void()> task;
+    for (int k = 0; k < n && !task; ++k) {
+        const int q = self >= 0 ? (self + k) % n : int((nextQueue.load() + unsigned(k)) % unsigned(n));
+        Queue &queue = *queues[q];
+        std::lock_guard<std::mutex> lock(queue.mtx);
+        if (queue.tasks.empty()) continue;
+        if (loop) {
+            auto it = std::find_if(queue.tasks.begin(), queue.tasks.end(), [&](const Task &t) { return t.loop == loop; });
+            if (it == queue.tasks.end()) continue;
+            task = std::move(it->fn);
+            queue.tasks.erase(it);
+        } else if (q == self) {
+            task = std::move(queue.tasks.back().fn);
+            queue.tasks.pop_back();
+        } else {
+            task = std::move(queue.tasks.front().fn);
+            queue.tasks.pop_front();
+        }
+    }
+    if (!task) return false;
+    pending.fetch_sub(1);
+    task();
+    return true;
+}
+
+bool ThreadPool::tryRunJob()
+{
+    std::function<void()> job;
+    {
+        std::lock_guard<std::mutex> lock(jobs.mtx);
+        if (jobs.tasks.empty()) return false;
+        job = std::move(jobs.tasks.front().fn);
+        jobs.tasks.pop_front();
+    }
+    pendingJobs.fetch_sub(1);
+    job();
+    return true;
+}
+
+void ThreadPool::run(int self, int cpu)
+{
+    t_pool = this;
+    t_index = self;
+    if (cpu >= 0) pin_to_cpu(cpu);
+    for (;;) {
+        if (tryRunOne(self, nullptr) || tryRunJob()) continue; // loop pieces first: someone waits on them
+        std::unique_lock<std::mutex> lock(sleepMtx);
+        taskReady.wait(lock, [this] { return pending.load() > 0 || pendingJobs.load() > 0 || stopping; });
+        if (stopping && pending.load() == 0 && pendingJobs.load() == 0) return; // stopping and drained
+    }
+}
+
+/**
+ * @brief The job thread: submit() jobs only, so one is always free to start them.
+ */
+void ThreadPool::runJobs()
+{
+    for (;;) {
+        if (tryRunJob()) continue;
+        std::unique_lock<std::mutex> lock(sleepMtx);
+        taskReady.wait(lock, [this] { return pendingJobs.load() > 0 || stopping; });
+        if (stopping && pendingJobs.load() == 0) return;
+    }
+}
+
+/**
+ * @brief Wait until done() holds, yielding between checks: the caller's core stays busy, so use
+ * @brief it only for short waits on something nothing signals. Runs nothing queued: whatever
+ * @brief done() waits on is a job or pieces of someone else's loop, both with their own threads.
+ */
+void ThreadPool::waitUntil(const std::function<bool()> &done)
+{
+    while (!done()) std::this_thread::yield();
+}
+
+/**
+ * @brief Call fn(i) for every i in [0, n) and return when all calls are done.
+ * @brief Indices are handed out dynamically; the caller works on them too instead of just waiting.
+ */
+void ThreadPool::parallelFor(int n, const std::function<void(int)> &fn)
+{
+    if (n <= 0) return;
+    std::atomic<int> next(0);
+    std::atomic<int> finished(0);
+    auto drain = [&] {
+        for (int i = next++; i < n; i = next++) fn(i);
+    };
+
+    const int helpers = std::min(size(), n - 1);
+    for (int h = 0; h < helpers; ++h)
+        enqueue({[&] {
+                     drain();
+                     finished.fetch_add(1);
+                 },
+                 &finished});
+    drain();
+    const int self = (t_pool == this) ? t_index : -1;
+    while (finished.load() != helpers) // our own pieces only, still queued if no worker was free
+        if (!tryRunOne(self, &finished)) std::this_thread::yield();
+}
+
+/**
+ * @brief fn(begin, end) over [0, rows) in blocks of about grain rows, in parallel.
+ */
+void ThreadPool::parallelForRows(long rows, long grain, const std::function<void(long, long)> &fn)
+{
+    if (rows <= 0) return;
+    grain = std::max(1L, grain);
+    const long blocks = (rows + grain - 1) / grain;
+    parallelFor(int(blocks), [&](int b) { fn(long(b) * grain, std::min(rows, long(b + 1) * grain)); });
+}
+
+ThreadPool &global_pool()
+{
+    static ThreadPool pool(pool_threads, pool_affinity);
+    return pool;
+}
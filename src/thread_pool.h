@@ -0,0 +1,97 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// How workers are pinned to the CPUs this process may run on.
+//   None    : let the OS schedule them
+//   Compact : worker i on the i-th allowed CPU (neighbouring cores / one socket first)
+//   Scatter : workers spread evenly over the allowed CPUs (across sockets / NUMA nodes)
+enum class Affinity { None, Compact, Scatter };
+
+// ====== SETTINGS ======
+extern int pool_threads;        // workers in global_pool(), 0 = hardware_concurrency() - 1
+extern Affinity pool_affinity;
+
+/**
+ * @brief Work-stealing pool: one deque per worker. A worker pushes and pops its own tasks at
+ * @brief the back and steals from the front of the others when it runs dry; tasks submitted
+ * @brief from outside are dealt round-robin. A thread waiting in parallelFor runs the queued
+ * @brief pieces of that same loop meanwhile, so nested parallel loops cannot deadlock, but never
+ * @brief anything else: a training step does not end up encoding a PNG or running an evaluation.
+ * @brief submit() jobs (writes, evaluations, prefetches) have their own queue, taken by idle
+ * @brief workers and by one extra job thread, so they progress even while every worker waits on one.
+ */
+class ThreadPool
+{
+public:
+    explicit ThreadPool(int threads = 0, Affinity affinity = Affinity::None); // 0 = hardware_concurrency() - 1
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    int size() const { return int(workers.size()); }
+
+    template <typename F>
+    auto submit(F fn) -> std::future<decltype(fn())>
+    {
+        auto task = std::make_shared<std::packaged_task<decltype(fn())()>>(std::move(fn));
+        std::future<decltype(fn())> result = task->get_future();
+        enqueueJob([task] { (*task)(); });
+        return result;
+    }
+
+    template <typename T>
+    T wait(std::future<T> &f)
+    {
+        f.wait(); // jobs are never run by the waiting thread, see the class comment
+        return f.get();
+    }
+
+    void parallelFor(int n, const std::function<void(int)> &fn);
+    void parallelForRows(long rows, long grain, const std::function<void(long, long)> &fn);
+    void waitUntil(const std::function<bool()> &done); // polls done(), runs nothing queued
+
+private:
+    struct Task
+    {
+        std::function<void()> fn;
+        const void *loop = nullptr; // the parallelFor call this piece belongs to
+    };
+    struct Queue
+    {
+        std::mutex mtx;
+        std::deque<Task> tasks;
+    };
+
+    void enqueue(Task task);
+    void enqueueJob(std::function<void()> job);
+    bool tryRunOne(int self, const void *loop);
+    bool tryRunJob();
+    void run(int self, int cpu);
+    void runJobs();
+
+    std::vector<std::unique_ptr<Queue>> queues; // parallelFor pieces, one per worker
+    Queue jobs;                                 // submit()
+    std::vector<std::thread> workers;
+    std::thread jobThread;
+    std::atomic<int> pending{0};
+    std::atomic<int> pendingJobs{0};
+    std::atomic<unsigned> nextQueue{0};
+    bool stopping = false;
+    std::mutex sleepMtx;
+    std::condition_variable taskReady;
+};
+
+ThreadPool &global_pool(); // shared by training, evaluation, batch generation and image writing
+
+#endif // THREAD_POOL_H
@@ -0,0 +1,81 @@
+#include "../augment.h"
+#include "../shape.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+// Usage: augment_preview --augment SPEC [--grid C] [--out FILE] [--seed S] [--train SPEC] [--test SPEC]
+//                        [--raw WxHxC] [--cache DIR]
+// The --augment SPEC is shift=P,rotate=DEG,scale=F,elastic=P,cell=P,noise=S (any subset, see augment.h).
+// Writes a C x C grid of training images whose odd rows are the even rows augmented, then
+// times augment_batch on batches of B images against the time a training batch takes to draw,
+// and checks that one thread and the whole pool produce the same batch.
+int main(int argc, char **argv)
+{
+    std::string out = "augment_preview.png";
+    int C = 8;
+    uint32_t seed = 1234;
+    for (int i = 1; i < argc; ++i) {
+        auto next = [&]() { return (i + 1 < argc) ? argv[++i] : (std::cerr << "missing value for " << argv[i] << "\n", std::exit(2), nullptr); };
+        if (parse_dataset_flag(argc, argv, i)) continue; // --train --test --raw --cache
+        if (!std::strcmp(argv[i], "--augment")) {
+            if (!set_augment(next())) return 2;
+        }
+        else if (!std::strcmp(argv[i], "--grid")) C = std::max(2, std::atoi(next()) / 2 * 2);
+        else if (!std::strcmp(argv[i], "--out")) out = next();
+        else if (!std::strcmp(argv[i], "--seed")) seed = uint32_t(std::atol(next()));
+        else {
+            std::cerr << "usage: " << argv[0] << " --augment SPEC [--grid C] [--out FILE] [--seed S]" << dataset_flags_usage << "\n";
+            return 2;
+        }
+    }
+    if (!augment_enabled()) {
+        std::cerr << "usage: " << argv[0] << " --augment SPEC [--grid C] [--out FILE] [--seed S]" << dataset_flags_usage << "\n";
+        return 2;
+    }
+    load_datasets();
+
+    std::mt19937 rng(seed);
+    const int pairs = C * C / 2;
+    MatrixXu8 originals;
+    dataset(true).sample(pairs, rng, originals);
+    MatrixXu8 augmented = originals;
+    augment_batch(augmented, image_shape, seed);
+    MatrixXu8 grid(C * C, originals.cols());
+    for (int r = 0; r < pairs; ++r) {
+        const int row = r / C * 2, col = r % C;
+        grid.row(row * C + col) = originals.row(r);
+        grid.row((row + 1) * C + col) = augmented.row(r);
+    }
+    if (!write_png_grid(grid.cast<float>() / 255.0f, C, C, out)) return 1;
+    std::cout << "Wrote " << out << ": " << pairs << " images above their augmented copies\n";
+
+    ThreadPool single(1);
+    MatrixXu8 again = originals;
+    augment_batch(again, image_shape, seed, single);
+    std::cout << "one thread vs " << global_pool().size() << "-thread pool: " << (again == augmented ? "identical" : "DIFFERENT") << "\n";
+
+    auto best_us = [](auto &&run) { // best of 5 rounds of 20 batches
+        double best = 1e30;
+        for (int round = 0; round < 5; ++round) {
+            const auto t0 = std::chrono::steady_clock::now();
+            for (int rep = 0; rep < 20; ++rep) run(rep);
+            best = std::min(best, std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count() / 20.0);
+        }
+        return best;
+    };
+    MatrixXu8 X;
+    dataset(true).sample(B, rng, X);
+    const MatrixXu8 batch = X;
+    const double augmentUs = best_us([&](int rep) {
+        X = batch;
+        augment_batch(X, image_shape, seed + uint64_t(rep));
+    });
+    const double copyUs = best_us([&](int) { X = batch; });
+    const double drawUs = best_us([&](int) { dataset(true).sample(B, rng, X); });
+    std::cout << "batch of " << B << ": augment " << augmentUs - copyUs << " us (" << double(B) / (augmentUs - copyUs) * 1e6
+              << " images/s), drawing it " << drawUs << " us\n";
+    return again == augmented ? 0 : 1;
+}
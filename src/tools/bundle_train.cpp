@@ -0,0 +1,129 @@
+#include "../bundle.h"
+#include "../shape.h"
+#include "../weight_store.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+// Usage: bundle_train [--hidden 32,64,128,256] [--copies K] [--lr R[,R...]] [--steps S] [--report N]
+//                     [--compare] [--out PREFIX] [--train SPEC] [--test SPEC] [--raw WxHxC] [--cache DIR]
+// Trains every listed width, K times each (different initialisations), as one bundle on shared
+// batches (see BundleTrainer), prints every model's loss each N steps and saves model m as
+// PREFIX<m>_h<H>.bin. --lr gives one rate per model, the last one repeating.
+// --compare also trains each model alone on the same batches (forwardPass, backPass, backProp)
+// and prints both times and the largest weight difference between the two runs.
+
+static std::vector<std::string> split(const std::string &list)
+{
+    std::vector<std::string> items;
+    std::stringstream ss(list);
+    for (std::string item; std::getline(ss, item, ',');)
+        if (!item.empty()) items.push_back(item);
+    return items;
+}
+
+static float max_diff(const Weights &a, const Weights &b)
+{
+    return std::max({(a.W1 - b.W1).cwiseAbs().maxCoeff(), (a.b1 - b.b1).cwiseAbs().maxCoeff(), (a.W2 - b.W2).cwiseAbs().maxCoeff(),
+                     (a.b2 - b.b2).cwiseAbs().maxCoeff(), (a.W3 - b.W3).cwiseAbs().maxCoeff(), (a.b3 - b.b3).cwiseAbs().maxCoeff()});
+}
+
+int main(int argc, char **argv)
+{
+    std::vector<int> widths = {32, 64, 128, 256};
+    std::vector<float> rates;
+    std::string prefix = "bundle_";
+    int copies = 1, steps = 2000, report = 500;
+    bool compare = false;
+    for (int i = 1; i < argc; ++i) {
+        auto next = [&]() { return (i + 1 < argc) ? argv[++i] : (std::cerr << "missing value for " << argv[i] << "\n", std::exit(2), nullptr); };
+        if (parse_dataset_flag(argc, argv, i)) continue; // --train --test --raw --cache
+        if (!std::strcmp(argv[i], "--hidden")) {
+            widths.clear();
+            for (const std::string &w : split(next())) widths.push_back(std::max(1, std::atoi(w.c_str())));
+        }
+        else if (!std::strcmp(argv[i], "--copies")) copies = std::max(1, std::atoi(next()));
+        else if (!std::strcmp(argv[i], "--lr")) for (const std::string &r : split(next())) rates.push_back(float(std::atof(r.c_str())));
+        else if (!std::strcmp(argv[i], "--steps")) steps = std::max(1, std::atoi(next()));
+        else if (!std::strcmp(argv[i], "--report")) report = std::max(1, std::atoi(next()));
+        else if (!std::strcmp(argv[i], "--compare")) compare = true;
+        else if (!std::strcmp(argv[i], "--out")) prefix = next();
+        else {
+            std::cerr << "usage: " << argv[0] << " [--hidden 32,64,128,256] [--copies K] [--lr R[,R...]] [--steps S] [--report N]"
+                      << " [--compare] [--out PREFIX]" << dataset_flags_usage << "\n";
+            return 2;
+        }
+    }
+    if (widths.empty()) {
+        std::cerr << "no --hidden widths\n";
+        return 2;
+    }
+
+    load_datasets(); // sets D
+    std::vector<Weights> initial;
+    for (int c = 0; c < copies; ++c)
+        for (int h : widths) initial.emplace_back(D, h);
+    BundleWeights bundle(initial, rates);
+    const int M = bundle.models();
+    const uint32_t seed = 1337u;
+
+    std::cout << M << " models, " << bundle.W1.cols() << " hidden units in all, B = " << B << ", " << global_pool().size() + 1 << " threads\n";
+    std::cout << std::setw(7) << "step";
+    for (int m = 0; m < M; ++m) std::cout << std::setw(9) << ("h" + std::to_string(bundle.hidden(m)) + "#" + std::to_string(m));
+    std::cout << "\n";
+
+    BundleTrainer trainer(global_pool(), seed);
+    const auto t0 = std::chrono::steady_clock::now();
+    for (int s = 1; s <= steps; ++s) {
+        trainer.step(bundle);
+        if (s % report == 0 || s == steps) {
+            std::cout << std::setw(7) << s << std::fixed << std::setprecision(5);
+            for (double l : trainer.losses()) std::cout << std::setw(9) << l;
+            std::cout << std::defaultfloat << "\n";
+        }
+    }
+    const double bundled = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    std::cout << "bundle: " << bundled * 1e3 / steps << " ms per step for " << M << " models\n";
+
+    for (int m = 0; m < M; ++m) {
+        const std::string path = prefix + std::to_string(m) + "_h" + std::to_string(bundle.hidden(m)) + ".bin";
+        if (!save_checkpoint(path, bundle.extract(m), size_t(steps))) return 1;
+    }
+    std::cout << "saved " << prefix << "<m>_h<H>.bin for m = 0.." << M - 1 << "\n";
+
+    if (!compare) return 0;
+    // Each model alone: the network code sizes its buffers from H_size and updates with lr.
+    const int oldH = H_size;
+    const double oldLr = lr;
+    double alone = 0.0;
+    float worst = 0.0f;
+    for (int m = 0; m < M; ++m) {
+        H_size = bundle.hidden(m);
+        lr = bundle.lr[size_t(m)];
+        Weights weights = initial[size_t(m)];
+        ForwardOutput forward;
+        Gradients gradients;
+        std::mt19937 rng(seed); // the bundle's batches
+        MatrixXu8 X;
+        SparseBatch Xs;
+        const auto t1 = std::chrono::steady_clock::now();
+        for (int s = 0; s < steps; ++s) {
+            X = make_batch_u8(B, rng, true, &Xs);
+            const SparseBatch *sparse = useSparseInput(Xs) ? &Xs : nullptr;
+            forwardPass(forward, weights, X, sparse);
+            backPass(gradients, forward, weights, X, sparse);
+            backProp(weights, gradients);
+        }
+        alone += std::chrono::duration<double>(std::chrono::steady_clock::now() - t1).count();
+        worst = std::max(worst, max_diff(weights, bundle.extract(m)));
+    }
+    H_size = oldH;
+    lr = oldLr;
+    std::cout << "alone:  " << alone * 1e3 / steps << " ms per step for " << M << " models (" << std::setprecision(3) << alone / bundled
+              << "x the bundle), max |dW| vs the bundle = " << worst << "\n";
+    return 0;
+}
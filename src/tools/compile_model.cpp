@@ -0,0 +1,199 @@
+#include "../network.h"
+#include "../weight_store.h"
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+
+// Usage: compile_model --checkpoint PATH [--out FILE] [--name NAMESPACE]
+// Compiles a checkpoint into a self-contained C++17 header for batch-1 inference: the weights
+// become aligned constexpr arrays (exact hex-float literals) and the forward pass a set of loops
+// with compile-time bounds, so the compiler can fully unroll and vectorise them for these exact
+// layer sizes. No Eigen, no heap, no libm calls. Same semantics as forwardPass:
+//   NAMESPACE::reconstruct(pixels, out) : u8 pixels in, sigmoid outputs out, returns the BCE
+// `make aot CHECKPOINT=PATH` generates the header and builds aot_check, which compares it
+// against forwardPass and times both.
+
+static void write_array(std::ostream &out, const char *name, int rows, int cols, const std::function<float(int, int)> &at)
+{
+    out << "alignas(64) inline constexpr float " << name;
+    if (rows > 1) out << "[" << rows << "]";
+    out << "[" << cols << "] = {";
+    for (int r = 0; r < rows; ++r) {
+        out << (rows > 1 ? "\n    {" : "\n    ");
+        for (int c = 0; c < cols; ++c) {
+            if (c > 0) out << (c % 8 == 0 ? ",\n     " : ", ");
+            out << std::hexfloat << at(r, c) << std::defaultfloat << "f"; // exact bits
+        }
+        out << (rows > 1 ? "}," : "");
+    }
+    out << "\n};\n\n";
+}
+
+int main(int argc, char **argv)
+{
+    std::string checkpoint, outPath = "aot_model.h", name = "aot_model";
+    for (int i = 1; i < argc; ++i) {
+        auto next = [&]() { return (i + 1 < argc) ? argv[++i] : (std::cerr << "missing value for " << argv[i] << "\n", std::exit(2), nullptr); };
+        if (!std::strcmp(argv[i], "--checkpoint")) checkpoint = next();
+        else if (!std::strcmp(argv[i], "--out")) outPath = next();
+        else if (!std::strcmp(argv[i], "--name")) name = next();
+        else {
+            std::cerr << "usage: " << argv[0] << " --checkpoint PATH [--out FILE] [--name NAMESPACE]\n";
+            return 2;
+        }
+    }
+    if (checkpoint.empty()) {
+        std::cerr << "usage: " << argv[0] << " --checkpoint PATH [--out FILE] [--name NAMESPACE]\n";
+        return 2;
+    }
+
+    Weights w; // takes the checkpoint's shapes
+    size_t iteration = 0;
+    if (!load_checkpoint(checkpoint, w, &iteration)) return 1;
+    const int inputs = int(w.W1.rows()), h1 = int(w.W1.cols()), h2 = int(w.W2.cols());
+
+    std::ostringstream out;
+    out << "// Generated by compile_model from " << checkpoint << " (iteration " << iteration << "). Do not edit.\n"
+        << "#pragma once\n#include <cmath>\n#include <cstdint>\n#include <cstring>\n\n"
+        << "namespace " << name << " {\n\n"
+        << "constexpr int kInputs = " << inputs << ";\n"
+        << "constexpr int kHidden1 = " << h1 << ";\n"
+        << "constexpr int kHidden2 = " << h2 << ";\n"
+        << "constexpr const char *kCheckpoint = \"" << std::filesystem::absolute(checkpoint).string() << "\"; // aot_check compares against it\n\n"
+        << "// Every matrix is [in][out]: each layer is a sum of input-scaled rows.\n";
+    write_array(out, "W1", inputs, h1, [&](int r, int c) { return w.W1(r, c); });
+    write_array(out, "b1", 1, h1, [&](int, int c) { return w.b1(c); });
+    write_array(out, "W2", h1, h2, [&](int r, int c) { return w.W2(r, c); });
+    write_array(out, "b2", 1, h2, [&](int, int c) { return w.b2(c); });
+    write_array(out, "W3", h2, inputs, [&](int r, int c) { return w.W3(r, c); });
+    write_array(out, "b3", 1, inputs, [&](int, int c) { return w.b3(c); });
+
+    out << R"(// acc[0..n) += x * row[0..n): fixed n, contiguous, no aliasing: unrolled and vectorised. Used for
+// the first layer, where most input pixels are 0 and their rows are skipped.
+template <int n>
+inline void axpy(float *__restrict acc, float x, const float *__restrict row)
+{
+    for (int j = 0; j < n; ++j) acc[j] += x * row[j];
+}
+
+// acc[0..cols) += in[0..rows) W, in column blocks that stay in registers for the whole row sweep
+// (an axpy per row would load and store the accumulator rows times).
+template <int rows, int cols>
+inline void gemv(float *__restrict acc, const float *__restrict in, const float (*__restrict W)[cols])
+{
+    constexpr int block = 32;
+    for (int c0 = 0; c0 + block <= cols; c0 += block) {
+        float a[block];
+        for (int j = 0; j < block; ++j) a[j] = acc[c0 + j];
+        for (int k = 0; k < rows; ++k)
+            for (int j = 0; j < block; ++j) a[j] += in[k] * W[k][c0 + j];
+        for (int j = 0; j < block; ++j) acc[c0 + j] = a[j];
+    }
+    for (int k = 0; k < rows; ++k)
+        for (int j = cols - cols % block; j < cols; ++j) acc[j] += in[k] * W[k][j];
+}
+
+// exp and log1p as branch-free polynomials (Cephes, relative error ~1e-7), so the loops over
+// whole layers vectorise; libm would be one call per element. Selects are fabs, copysign
+// or a 0/1 mask: without -ffast-math the compiler does not reliably if-convert anything else.
+inline float bits_to_float(int32_t i)
+{
+    float f;
+    std::memcpy(&f, &i, sizeof(f));
+    return f;
+}
+
+inline float exp_poly(float x)
+{
+    x += (x < -87.0f ? 1.0f : 0.0f) * (-87.0f - x); // clamp to [-87, 88]
+    x += (x > 88.0f ? 1.0f : 0.0f) * (88.0f - x);
+    const int32_t n = int32_t(x * 1.44269504f + 128.5f) - 128; // round(x / ln 2): positive, so truncation floors
+    const float r = x - float(n) * 0.693359375f + float(n) * 2.12194440e-4f;
+    float p = 1.9875691500e-4f;
+    p = p * r + 1.3981999507e-3f;
+    p = p * r + 8.3334519073e-3f;
+    p = p * r + 4.1665795894e-2f;
+    p = p * r + 1.6666665459e-1f;
+    p = p * r + 5.0000001201e-1f;
+    p = p * r * r + r + 1.0f;
+    return p * bits_to_float((n + 127) << 23); // * 2^n
+}
+
+inline float log1p_poly(float t) // t in [0, 1]
+{
+    const float big = t > 0.41421356f ? 1.0f : 0.0f; // 1 + t > sqrt(2): halve it
+    const float f = t + big * ((t - 1.0f) * 0.5f - t);
+    const float z = f * f;
+    float p = 7.0376836292e-2f;
+    p = p * f - 1.1514610310e-1f;
+    p = p * f + 1.1676998740e-1f;
+    p = p * f - 1.2420140846e-1f;
+    p = p * f + 1.4249322787e-1f;
+    p = p * f - 1.6668057665e-1f;
+    p = p * f + 2.0000714765e-1f;
+    p = p * f - 2.4999993993e-1f;
+    p = p * f + 3.3333331174e-1f;
+    return f * z * p - 0.5f * z + f + big * 0.693147181f;
+}
+
+template <int n>
+inline void tanh_inplace(float *v)
+{
+    for (int j = 0; j < n; ++j) {
+        const float e = exp_poly(-2.0f * std::fabs(v[j])); // in (0, 1]: no overflow
+        v[j] = std::copysign((1.0f - e) / (1.0f + e), v[j]);
+    }
+}
+
+/**
+ * @brief One image through the network, as forwardPass: out = sigmoid(tanh(tanh(x W1 + b1) W2 + b2) W3 + b3)
+ * @brief with x = pixels / 255. Stack buffers only.
+ * @param pixels const : kInputs raw pixels, 0..255.
+ * @param out REFERENCE : kInputs reconstructed pixels in (0, 1).
+ * @return Binary cross-entropy, mean over the pixels.
+ */
+inline float reconstruct(const uint8_t *pixels, float *out)
+{
+    alignas(64) float h[kHidden1];
+    alignas(64) float a2[kHidden2];
+    alignas(64) float z[kInputs];
+    alignas(64) float bce[kInputs];
+    for (int j = 0; j < kHidden1; ++j) h[j] = b1[j];
+    for (int i = 0; i < kInputs; ++i)
+        if (pixels[i]) axpy<kHidden1>(h, float(pixels[i]) * (1.0f / 255.0f), W1[i]); // background pixels skip their row
+    tanh_inplace<kHidden1>(h);
+
+    for (int j = 0; j < kHidden2; ++j) a2[j] = b2[j];
+    gemv<kHidden1, kHidden2>(a2, h, W2);
+    tanh_inplace<kHidden2>(a2);
+
+    for (int d = 0; d < kInputs; ++d) z[d] = b3[d];
+    gemv<kHidden2, kInputs>(z, a2, W3);
+    for (int d = 0; d < kInputs; ++d) { // from the logit: one exp, one log per pixel
+        const float x = float(pixels[d]) * (1.0f / 255.0f), abs = std::fabs(z[d]);
+        const float t = exp_poly(-abs), negative = z[d] < 0.0f ? 1.0f : 0.0f;
+        bce[d] = 0.5f * (abs - z[d]) + log1p_poly(t) + (1.0f - x) * z[d]; // softplus(-z) + (1 - x) z
+        out[d] = (1.0f + negative * (t - 1.0f)) / (1.0f + t);               // z < 0 ? t / (1 + t) : 1 / (1 + t)
+    }
+    float lanes[8] = {};
+    for (int d = 0; d < kInputs; ++d) lanes[d % 8] += bce[d];
+    float loss = 0.0f;
+    for (float l : lanes) loss += l;
+    return loss / float(kInputs);
+}
+
+} // namespace )" << name << "\n";
+
+    std::ofstream file(outPath);
+    file << out.str();
+    if (!file) {
+        std::cerr << "ERROR: cannot write " << outPath << "\n";
+        return 1;
+    }
+    std::cout << "Wrote " << outPath << ": " << inputs << " -> " << h1 << " -> " << h2 << " -> " << inputs << " (namespace " << name << ")\n";
+    return 0;
+}
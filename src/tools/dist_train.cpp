@@ -0,0 +1,224 @@
+#include "../distributed.h"
+#include "../shape.h"
+#include "../thread_pool.h"
+#include "../train.h"
+#include "../weight_store.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Usage: dist_train [--workers N | --scaling MAX] [--transport shm|tcp] [--host H] [--port P] [--steps S]
+//                   [--warmup S] [--no-overlap] [--verify] [--train SPEC] [--test SPEC] [--raw WxHxC]
+//                   [--cache DIR] [--checkpoint PATH]
+//        dist_train --rank R --world N --peers SPEC [--steps S] [...]
+// Data-parallel training (see DistributedTrainer). The first form forks N local ranks, or one job
+// per rank count 1..MAX with --scaling, and reports throughput, the time the backward waited on
+// the all-reduce, and whether the replicas ended bit-identical; --scaling adds the efficiency
+// thr(n) / (n thr(1)) against its 1-rank job. The second form is one rank of a job spread over machines, e.g.
+//   --peers tcp:10.0.0.1:29500,10.0.0.2:29500   (rank r listens on the r-th address).
+// --verify: rank 0 replays the run with Trainer(accum_steps = N) and prints the largest weight difference.
+
+struct Options
+{
+    std::string transport = "shm", host = "127.0.0.1", checkpoint;
+    int port = 29500;
+    int steps = 200;
+    int warmup = 10;
+    bool verify = false;
+};
+
+struct RankReport // one fixed-size write per rank through the pipe
+{
+    int rank;
+    int ok;
+    double seconds;     // timed steps
+    double waitSeconds; // backward done, waiting on the all-reduce
+    double commSeconds; // inside allreduce()
+    double loss;        // last step, mean over ranks
+    uint64_t weightHash;
+    double verifyDiff;  // -1 unless --verify on rank 0
+};
+
+static uint64_t weights_hash(const Weights &w)
+{
+    uint64_t h = 1469598103934665603ull; // FNV-1a over the raw bits
+    auto mix = [&](const float *p, Eigen::Index n) {
+        const unsigned char *c = reinterpret_cast<const unsigned char *>(p);
+        for (size_t i = 0; i < size_t(n) * sizeof(float); ++i) h = (h ^ c[i]) * 1099511628211ull;
+    };
+    mix(w.W1.data(), w.W1.size());
+    mix(w.b1.data(), w.b1.size());
+    mix(w.W2.data(), w.W2.size());
+    mix(w.b2.data(), w.b2.size());
+    mix(w.W3.data(), w.W3.size());
+    mix(w.b3.data(), w.b3.size());
+    return h;
+}
+
+static float max_diff(const Weights &a, const Weights &b)
+{
+    return std::max({(a.W1 - b.W1).cwiseAbs().maxCoeff(), (a.b1 - b.b1).cwiseAbs().maxCoeff(), (a.W2 - b.W2).cwiseAbs().maxCoeff(),
+                     (a.b2 - b.b2).cwiseAbs().maxCoeff(), (a.W3 - b.W3).cwiseAbs().maxCoeff(), (a.b3 - b.b3).cwiseAbs().maxCoeff()});
+}
+
+static RankReport run_rank(const std::string &spec, int rank, int world, const Options &opts)
+{
+    RankReport report{rank, 0, 0.0, 0.0, 0.0, 0.0, 0, -1.0};
+    load_datasets(); // sets D
+    Weights weights;
+    std::unique_ptr<Transport> transport = open_transport(spec, rank, world, largest_bucket(weights));
+    if (!transport) return report;
+    const uint32_t seed = 1337u;
+    DistributedTrainer trainer(*transport, seed);
+    if (!trainer.syncWeights(weights)) return report;
+    const Weights initial = weights;
+
+    double loss = 0.0;
+    for (int s = 0; s < opts.warmup; ++s)
+        if (!trainer.step(weights, loss)) return report;
+    const double wait0 = trainer.commWaitSeconds(), comm0 = trainer.commSeconds();
+    const auto t0 = std::chrono::steady_clock::now();
+    for (int s = 0; s < opts.steps; ++s)
+        if (!trainer.step(weights, loss)) return report;
+    report.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    report.waitSeconds = trainer.commWaitSeconds() - wait0;
+    report.commSeconds = trainer.commSeconds() - comm0;
+    report.loss = loss;
+    report.weightHash = weights_hash(weights);
+    report.ok = 1;
+
+    if (rank == 0 && opts.verify) {
+        Weights replay = initial;
+        Trainer reference(global_pool(), world, seed); // micro-batch k draws from seed + k, like rank k
+        for (int s = 0; s < opts.warmup + opts.steps; ++s) reference.step(replay);
+        report.verifyDiff = max_diff(weights, replay);
+    }
+    if (rank == 0 && !opts.checkpoint.empty() && !save_checkpoint(opts.checkpoint, weights, size_t(opts.warmup + opts.steps))) report.ok = 0;
+    return report;
+}
+
+/**
+ * @brief Fork world local ranks, collect their reports. Called before this process starts any
+ * @brief thread: every child builds its own pool and loads its own datasets.
+ */
+static bool run_local(int world, const Options &opts, std::vector<RankReport> &reports)
+{
+    const std::string spec = opts.transport == "tcp" ? "tcp:" + opts.host + ":" + std::to_string(opts.port)
+                                                     : "shm:vae_dist_" + std::to_string(getpid()) + "_" + std::to_string(world);
+    int fds[2];
+    if (pipe(fds) != 0) {
+        std::cerr << "ERROR: pipe failed\n";
+        return false;
+    }
+    std::vector<pid_t> children;
+    for (int r = 0; r < world; ++r) {
+        const pid_t pid = fork();
+        if (pid == 0) {
+            close(fds[0]);
+            const RankReport report = run_rank(spec, r, world, opts);
+            const bool written = write(fds[1], &report, sizeof(report)) == ssize_t(sizeof(report)); // < PIPE_BUF: atomic
+            _exit(written && report.ok ? 0 : 1);
+        }
+        if (pid < 0) {
+            std::cerr << "ERROR: fork failed\n";
+            break;
+        }
+        children.push_back(pid);
+    }
+    close(fds[1]);
+    reports.clear();
+    RankReport report;
+    while (read(fds[0], &report, sizeof(report)) == ssize_t(sizeof(report))) reports.push_back(report);
+    close(fds[0]);
+    bool ok = int(children.size()) == world;
+    for (pid_t pid : children) {
+        int status = 0;
+        waitpid(pid, &status, 0);
+        ok = ok && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    }
+    std::sort(reports.begin(), reports.end(), [](const RankReport &a, const RankReport &b) { return a.rank < b.rank; });
+    return ok && int(reports.size()) == world;
+}
+
+int main(int argc, char **argv)
+{
+    Options opts;
+    int workers = 2, scaling = 0, rank = -1, world = 0;
+    std::string peers;
+    for (int i = 1; i < argc; ++i) {
+        auto next = [&]() { return (i + 1 < argc) ? argv[++i] : (std::cerr << "missing value for " << argv[i] << "\n", std::exit(2), nullptr); };
+        if (parse_dataset_flag(argc, argv, i)) continue; // --train --test --raw --cache
+        if (!std::strcmp(argv[i], "--workers")) workers = std::max(1, std::atoi(next()));
+        else if (!std::strcmp(argv[i], "--scaling")) scaling = std::max(1, std::atoi(next()));
+        else if (!std::strcmp(argv[i], "--transport")) opts.transport = next();
+        else if (!std::strcmp(argv[i], "--host")) opts.host = next();
+        else if (!std::strcmp(argv[i], "--port")) opts.port = std::atoi(next());
+        else if (!std::strcmp(argv[i], "--steps")) opts.steps = std::max(1, std::atoi(next()));
+        else if (!std::strcmp(argv[i], "--warmup")) opts.warmup = std::max(0, std::atoi(next()));
+        else if (!std::strcmp(argv[i], "--no-overlap")) overlap_allreduce = false;
+        else if (!std::strcmp(argv[i], "--verify")) opts.verify = true;
+        else if (!std::strcmp(argv[i], "--checkpoint")) opts.checkpoint = next();
+        else if (!std::strcmp(argv[i], "--rank")) rank = std::atoi(next());
+        else if (!std::strcmp(argv[i], "--world")) world = std::atoi(next());
+        else if (!std::strcmp(argv[i], "--peers")) peers = next();
+        else {
+            std::cerr << "usage: " << argv[0] << " [--workers N | --scaling MAX] [--transport shm|tcp] [--host H] [--port P] [--steps S]"
+                      << " [--warmup S] [--no-overlap] [--verify]" << dataset_flags_usage << " [--checkpoint PATH]\n"
+                      << "       " << argv[0] << " --rank R --world N --peers SPEC [--steps S] [...]\n";
+            return 2;
+        }
+    }
+    if (opts.transport != "shm" && opts.transport != "tcp") {
+        std::cerr << "unknown transport: " << opts.transport << "\n";
+        return 2;
+    }
+
+    if (rank >= 0) { // one rank of a multi-machine job
+        const RankReport r = run_rank(peers, rank, world, opts);
+        if (!r.ok) return 1;
+        std::cout << "rank " << rank << "/" << world << ": " << std::fixed << std::setprecision(1) << double(B) * opts.steps / r.seconds
+                  << " samples/s, waited " << 100.0 * r.waitSeconds / r.seconds << "% on the all-reduce, loss " << std::setprecision(5) << r.loss
+                  << ", weights " << std::hex << r.weightHash << std::dec << "\n";
+        return 0;
+    }
+
+    std::cout << "transport " << opts.transport << ", B = " << B << " per rank, " << opts.steps << " steps, overlap "
+              << (overlap_allreduce ? "on" : "off") << "\n";
+    std::cout << "ranks  samples/s" << (scaling > 0 ? "  efficiency" : "") << "  wait%   comm%   loss      replicas\n";
+    double base = 0.0; // per-rank throughput of the 1-rank job
+    const int first = scaling > 0 ? 1 : workers, last = scaling > 0 ? scaling : workers;
+    for (int n = first; n <= last; ++n) {
+        std::vector<RankReport> reports;
+        if (!run_local(n, opts, reports)) {
+            std::cerr << "ERROR: job with " << n << " ranks failed\n";
+            return 1;
+        }
+        double slowest = 0.0, wait = 0.0, comm = 0.0;
+        bool identical = true;
+        for (const RankReport &r : reports) {
+            slowest = std::max(slowest, r.seconds);
+            wait += r.waitSeconds / r.seconds / n;
+            comm += r.commSeconds / r.seconds / n;
+            identical = identical && r.weightHash == reports[0].weightHash;
+        }
+        const double throughput = double(B) * n * opts.steps / slowest;
+        if (n == 1) base = throughput;
+        std::cout << std::setw(5) << n << "  " << std::fixed << std::setprecision(1) << std::setw(9) << throughput << "  ";
+        if (scaling > 0) std::cout << std::setprecision(2) << std::setw(10) << throughput / (n * base) << "  ";
+        std::cout << std::setprecision(1) << std::setw(5)
+                  << 100.0 * wait << "  " << std::setw(6) << 100.0 * comm << "  " << std::setprecision(5) << reports[0].loss << "   "
+                  << (identical ? "identical" : "DIVERGED") << "\n";
+        if (reports[0].verifyDiff >= 0.0)
+            std::cout << "       vs Trainer(accum_steps = " << n << "): max |dW| = " << std::scientific << std::setprecision(2)
+                      << reports[0].verifyDiff << std::defaultfloat << "\n";
+        if (!identical) return 1;
+    }
+    return 0;
+}
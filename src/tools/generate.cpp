@@ -0,0 +1,110 @@
+#include "../latent.h"
+#include "../shape.h"
+#include "../snapshot.h"
+#include "../weight_store.h"
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+// Usage: generate [--checkpoint PATH] [--mode sample|lerp|slerp|grid] [--images N] [--grid C]
+//                 [--out PREFIX] [--seed S] [--train SPEC] [--test SPEC] [--raw WxHxC] [--cache DIR]
+// Decodes N latents into C x C PNG grids named PREFIX00000.png, PREFIX00001.png, ...
+//   sample     : draws from a Gaussian fitted to the codes of 10k training images
+//   lerp/slerp : each grid row walks from the code of one test image to another's
+//   grid       : 2D sweep around the mean code, along the codes of two test images
+int main(int argc, char **argv)
+{
+    std::string checkpoint, mode = "sample", prefix = "gen_";
+    long images = 4096;
+    int C = 8;
+    uint32_t seed = 1234;
+    for (int i = 1; i < argc; ++i) {
+        auto next = [&]() { return (i + 1 < argc) ? argv[++i] : (std::cerr << "missing value for " << argv[i] << "\n", std::exit(2), nullptr); };
+        if (parse_dataset_flag(argc, argv, i)) continue; // --train --test --raw --cache
+        if (!std::strcmp(argv[i], "--checkpoint")) checkpoint = next();
+        else if (!std::strcmp(argv[i], "--mode")) mode = next();
+        else if (!std::strcmp(argv[i], "--images")) images = std::atol(next());
+        else if (!std::strcmp(argv[i], "--grid")) C = std::max(1, std::atoi(next()));
+        else if (!std::strcmp(argv[i], "--out")) prefix = next();
+        else if (!std::strcmp(argv[i], "--seed")) seed = uint32_t(std::atoi(next()));
+        else {
+            std::cerr << "usage: " << argv[0] << " [--checkpoint PATH] [--mode sample|lerp|slerp|grid] [--images N] [--grid C] [--out PREFIX] [--seed S]"
+                      << dataset_flags_usage << "\n";
+            return 2;
+        }
+    }
+    if (mode != "sample" && mode != "lerp" && mode != "slerp" && mode != "grid") {
+        std::cerr << "unknown mode: " << mode << "\n";
+        return 2;
+    }
+
+    load_datasets(); // sets D
+    Weights weights;
+    if (!checkpoint.empty()) {
+        if (!load_checkpoint(checkpoint, weights)) return 1;
+        if (weights.W1.rows() != D) {
+            std::cerr << "checkpoint has D=" << weights.W1.rows() << ", the dataset has D=" << D << "\n";
+            return 1;
+        }
+    } else {
+        std::cerr << "WARNING: no --checkpoint, decoding with untrained weights\n";
+    }
+
+    // Codes the latents are built from: a prior fitted on training images, endpoints from test images.
+    MatrixXfRow trainCodes, testCodes;
+    MatrixXu8 X;
+    dataset(true).read(0, 10000, X);
+    encode(weights, X, trainCodes);
+    dataset(false).read(0, dataset(false).size(), X);
+    encode(weights, X, testCodes);
+    const LatentGaussian prior = fit_latent_gaussian(trainCodes);
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<int> pick(0, int(testCodes.rows()) - 1);
+
+    const long perGrid = long(C) * C;
+    const long grids = std::max(1L, (images + perGrid - 1) / perGrid);
+    const long gridsPerChunk = std::max(1L, 4096 / perGrid); // latents built and decoded in bulk, a chunk at a time
+
+    SnapshotWriter writer(8);
+    MatrixXfRow latents, decoded;
+    double decodeSecs = 0.0;
+    const auto t0 = std::chrono::steady_clock::now();
+    for (long g0 = 0; g0 < grids; g0 += gridsPerChunk) {
+        const long n = std::min(gridsPerChunk, grids - g0);
+        latents.resize(n * perGrid, prior.mean.cols());
+        for (long g = 0; g < n; ++g) {
+            auto block = latents.middleRows(g * perGrid, perGrid);
+            if (mode == "sample") {
+                block = sample_latents(prior, int(perGrid), rng);
+            } else if (mode == "grid") {
+                const Eigen::RowVectorXf u = testCodes.row(pick(rng)) - prior.mean;
+                const Eigen::RowVectorXf v = testCodes.row(pick(rng)) - prior.mean;
+                block = latent_grid(prior.mean, u, v, C, C);
+            } else {
+                for (int r = 0; r < C; ++r)
+                    block.middleRows(r * C, C) = interpolate_latents(testCodes.row(pick(rng)), testCodes.row(pick(rng)), C, mode == "slerp");
+            }
+        }
+
+        const auto d0 = std::chrono::steady_clock::now();
+        decode(weights, latents, decoded);
+        decodeSecs += std::chrono::duration<double>(std::chrono::steady_clock::now() - d0).count();
+
+        for (long g = 0; g < n; ++g) {
+            std::ostringstream path;
+            path << prefix << std::setw(5) << std::setfill('0') << (g0 + g) << ".png";
+            writer.submitBlocking(decoded.middleRows(g * perGrid, perGrid), C, C, path.str());
+        }
+    }
+    writer.flush();
+    const double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+    const double decodedImages = double(grids * perGrid);
+    std::cout << mode << ": " << decodedImages << " images in " << grids << " grids of " << C << "x" << C << "\n"
+              << "decode     : " << decodedImages / decodeSecs << " images/s (" << decodeSecs << " s)\n"
+              << "end to end : " << decodedImages / secs << " images/s (" << secs << " s, PNG writes included)\n";
+    return 0;
+}
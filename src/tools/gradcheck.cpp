@@ -0,0 +1,52 @@
+#include "../gradcheck.h"
+#include "../shape.h"
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+// Usage: gradcheck [--mnist] [--sparse] [--samples N] [--threads T] [--eps E] [--tol T] [--seed S]
+//                  [--train SPEC] [--test SPEC] [--raw WxHxC] [--cache DIR]
+// Checks backPass() at the production sizes (B x D -> H_size -> H_size -> D; D from the dataset with --mnist,
+// a batch of training images).
+// Exit status is 1 if any sampled coordinate exceeds the tolerance.
+int main(int argc, char **argv)
+{
+    GradCheckOptions opts;
+    bool mnist = false;
+    for (int i = 1; i < argc; ++i) {
+        auto next = [&]() { return (i + 1 < argc) ? argv[++i] : (std::cerr << "missing value for " << argv[i] << "\n", std::exit(2), nullptr); };
+        if (parse_dataset_flag(argc, argv, i)) continue; // --train --test --raw --cache
+        if (!std::strcmp(argv[i], "--mnist")) mnist = true;
+        else if (!std::strcmp(argv[i], "--sparse")) opts.sparseInput = true;
+        else if (!std::strcmp(argv[i], "--samples")) opts.samplesPerTensor = std::atoi(next());
+        else if (!std::strcmp(argv[i], "--threads")) opts.threads = std::atoi(next());
+        else if (!std::strcmp(argv[i], "--eps")) opts.eps = std::atof(next());
+        else if (!std::strcmp(argv[i], "--tol")) opts.tolerance = std::atof(next());
+        else if (!std::strcmp(argv[i], "--seed")) opts.seed = uint32_t(std::atoi(next()));
+        else {
+            std::cerr << "usage: " << argv[0] << " [--mnist] [--sparse] [--samples N] [--threads T] [--eps E] [--tol T] [--seed S]" << dataset_flags_usage << "\n";
+            return 2;
+        }
+    }
+
+    if (mnist) load_datasets(); // sets D
+    std::mt19937 rng(opts.seed);
+    MatrixXfRow X = mnist ? make_batch(B, rng, true)
+                          : MatrixXfRow((MatrixXfRow::Random(B, D).array() * 0.5f + 0.5f).matrix());
+    Weights weights;
+
+    auto t0 = std::chrono::steady_clock::now();
+    std::vector<GradCheckResult> results = gradCheck(weights, X, opts);
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+    std::cout << "B=" << B << " D=" << D << " H=" << H_size << "  eps=" << opts.eps << " tol=" << opts.tolerance << "\n";
+    printGradCheck(results, std::cout);
+    int failures = 0, checked = 0;
+    for (const GradCheckResult &r : results) {
+        failures += r.failures;
+        checked += r.checked;
+    }
+    std::cout << checked << " coordinates in " << secs << " s, " << failures << " above tolerance\n";
+    return failures > 0 ? 1 : 0;
+}
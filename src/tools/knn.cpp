@@ -0,0 +1,95 @@
+#include "../latent.h"
+#include "../latent_index.h"
+#include "../shape.h"
+#include "../weight_store.h"
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+// Usage: knn [--checkpoint PATH] [--k K] [--queries Q] [--nlist L] [--nprobe 1,4,16,...]
+//            [--train SPEC] [--test SPEC] [--raw WxHxC] [--cache DIR]
+// Encodes every train and test image, indexes their codes, and reports queries/s for the exact
+// (single query and blocked batch) and IVF searches, with IVF recall@k against the exact result.
+// Queries are the codes of the first Q test images (each also finds itself at distance 0).
+int main(int argc, char **argv)
+{
+    std::string checkpoint, nprobeList = "1,2,4,8,16,32";
+    int k = 10, nQueries = 1000, nlist = 256;
+    for (int i = 1; i < argc; ++i) {
+        auto next = [&]() { return (i + 1 < argc) ? argv[++i] : (std::cerr << "missing value for " << argv[i] << "\n", std::exit(2), nullptr); };
+        if (parse_dataset_flag(argc, argv, i)) continue; // --train --test --raw --cache
+        if (!std::strcmp(argv[i], "--checkpoint")) checkpoint = next();
+        else if (!std::strcmp(argv[i], "--k")) k = std::max(1, std::atoi(next()));
+        else if (!std::strcmp(argv[i], "--queries")) nQueries = std::max(1, std::atoi(next()));
+        else if (!std::strcmp(argv[i], "--nlist")) nlist = std::max(1, std::atoi(next()));
+        else if (!std::strcmp(argv[i], "--nprobe")) nprobeList = next();
+        else {
+            std::cerr << "usage: " << argv[0] << " [--checkpoint PATH] [--k K] [--queries Q] [--nlist L] [--nprobe 1,4,16,...]"
+                      << dataset_flags_usage << "\n";
+            return 2;
+        }
+    }
+
+    load_datasets(); // sets D
+    Weights weights;
+    if (!checkpoint.empty()) {
+        if (!load_checkpoint(checkpoint, weights)) return 1;
+        if (weights.W1.rows() != D) {
+            std::cerr << "checkpoint has D=" << weights.W1.rows() << ", the dataset has D=" << D << "\n";
+            return 1;
+        }
+    } else {
+        std::cerr << "WARNING: no --checkpoint, indexing codes of untrained weights\n";
+    }
+
+    auto seconds = [](auto t0) { return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count(); };
+    auto t0 = std::chrono::steady_clock::now();
+    MatrixXfRow trainCodes, testCodes;
+    MatrixXu8 X;
+    dataset(true).read(0, dataset(true).size(), X);
+    encode(weights, X, trainCodes);
+    dataset(false).read(0, dataset(false).size(), X);
+    encode(weights, X, testCodes);
+    MatrixXfRow codes(trainCodes.rows() + testCodes.rows(), trainCodes.cols());
+    codes << trainCodes, testCodes;
+    std::cout << "encoded " << codes.rows() << " images to " << codes.cols() << "-d codes in " << seconds(t0) << " s\n";
+
+    t0 = std::chrono::steady_clock::now();
+    FlatIndex flat;
+    flat.add(codes);
+    std::cout << "flat index built in " << seconds(t0) << " s\n";
+    t0 = std::chrono::steady_clock::now();
+    IVFIndex ivf(nlist);
+    ivf.train(codes);
+    ivf.add(codes);
+    std::cout << "IVF index (nlist=" << ivf.nlist() << ") built in " << seconds(t0) << " s\n\n";
+
+    const MatrixXfRow queries = testCodes.topRows(std::min<Eigen::Index>(nQueries, testCodes.rows()));
+    const double nq = double(queries.rows());
+
+    t0 = std::chrono::steady_clock::now();
+    for (Eigen::Index q = 0; q < queries.rows(); ++q) flat.search(Eigen::RowVectorXf(queries.row(q)), k);
+    std::cout << std::left << std::setw(26) << "flat, one at a time" << nq / seconds(t0) << " queries/s\n";
+
+    t0 = std::chrono::steady_clock::now();
+    const auto exact = flat.search(queries, k);
+    std::cout << std::setw(26) << "flat, blocked batch" << nq / seconds(t0) << " queries/s\n";
+
+    std::stringstream probes(nprobeList);
+    std::string item;
+    while (std::getline(probes, item, ',')) {
+        const int nprobe = std::atoi(item.c_str());
+        if (nprobe <= 0) continue;
+        t0 = std::chrono::steady_clock::now();
+        const auto approx = ivf.search(queries, k, nprobe);
+        const double qps = nq / seconds(t0);
+        std::ostringstream label;
+        label << "ivf, nprobe=" << nprobe;
+        std::cout << std::setw(26) << label.str() << qps << " queries/s   recall@" << k << " "
+                  << recall_at_k(exact, approx, k) << "\n";
+    }
+    return 0;
+}
@@ -0,0 +1,122 @@
+#include "../eval.h"
+#include "../prune.h"
+#include "../shape.h"
+#include "../weight_store.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+// Usage: prune [--checkpoint PATH] [--criterion magnitude|activation|both] [--keep F,F,...]
+//              [--stats-images N] [--out PREFIX] [--train SPEC] [--test SPEC] [--raw WxHxC] [--cache DIR]
+// For every kept fraction F of the hidden units (both layers), prunes the checkpoint, compacts it
+// into smaller dense matrices, and prints the test BCE, the latency of one image and the
+// throughput of 256-image batches: the latency/accuracy curve. --out saves each pruned model as
+// PREFIX<criterion>_<percent>.bin, loadable by every tool.
+
+static double single_image_us(const Weights &weights, const MatrixXu8 &X)
+{
+    ForwardOutput forward;
+    std::vector<MatrixXu8> images;
+    for (Eigen::Index r = 0; r < X.rows(); ++r) images.push_back(X.row(r));
+    double best = 1e30;
+    for (int round = 0; round < 5; ++round) { // best median of 5 rounds: robust to a busy machine
+        std::vector<double> us;
+        for (size_t rep = 0; rep < 500; ++rep) {
+            const auto t0 = std::chrono::steady_clock::now();
+            forwardPass(forward, weights, images[rep % images.size()]);
+            us.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count());
+        }
+        std::nth_element(us.begin(), us.begin() + long(us.size() / 2), us.end());
+        best = std::min(best, us[us.size() / 2]);
+    }
+    return best;
+}
+
+static double batch_images_per_s(const Weights &weights, const MatrixXu8 &X)
+{
+    ForwardOutput forward;
+    double best = 0.0;
+    for (int round = 0; round < 5; ++round) {
+        const int reps = 10;
+        const auto t0 = std::chrono::steady_clock::now();
+        for (int rep = 0; rep < reps; ++rep) forwardPass(forward, weights, X);
+        best = std::max(best, double(reps) * double(X.rows()) / std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count());
+    }
+    return best;
+}
+
+int main(int argc, char **argv)
+{
+    std::string checkpoint, criteria = "both", prefix;
+    std::vector<double> keep = {1.0, 0.875, 0.75, 0.625, 0.5, 0.375, 0.25, 0.125};
+    for (int i = 1; i < argc; ++i) {
+        auto next = [&]() { return (i + 1 < argc) ? argv[++i] : (std::cerr << "missing value for " << argv[i] << "\n", std::exit(2), nullptr); };
+        if (parse_dataset_flag(argc, argv, i)) continue; // --train --test --raw --cache
+        if (!std::strcmp(argv[i], "--checkpoint")) checkpoint = next();
+        else if (!std::strcmp(argv[i], "--criterion")) criteria = next();
+        else if (!std::strcmp(argv[i], "--keep")) {
+            keep.clear();
+            std::stringstream ss(next());
+            for (std::string f; std::getline(ss, f, ',');)
+                if (!f.empty()) keep.push_back(std::clamp(std::atof(f.c_str()), 0.0, 1.0));
+        }
+        else if (!std::strcmp(argv[i], "--stats-images")) prune_stats_images = size_t(std::max(1, std::atoi(next())));
+        else if (!std::strcmp(argv[i], "--out")) prefix = next();
+        else {
+            std::cerr << "usage: " << argv[0] << " [--checkpoint PATH] [--criterion magnitude|activation|both] [--keep F,F,...]"
+                      << " [--stats-images N] [--out PREFIX]" << dataset_flags_usage << "\n";
+            return 2;
+        }
+    }
+    if (criteria != "magnitude" && criteria != "activation" && criteria != "both") {
+        std::cerr << "unknown criterion: " << criteria << "\n";
+        return 2;
+    }
+
+    load_datasets(); // sets D
+    Weights weights;
+    if (!checkpoint.empty()) {
+        if (!load_checkpoint(checkpoint, weights)) return 1;
+        if (weights.W1.rows() != D) {
+            std::cerr << "checkpoint has D=" << weights.W1.rows() << ", the dataset has D=" << D << "\n";
+            return 1;
+        }
+    } else {
+        std::cerr << "WARNING: no --checkpoint, pruning untrained weights\n";
+    }
+
+    const UnitStats stats = gather_unit_stats(weights, prune_stats_images);
+    MatrixXu8 X;
+    dataset(false).read(0, 256, X);
+    const int h1 = int(weights.W1.cols()), h2 = int(weights.W2.cols());
+    const double baseBce = evaluate(weights).bce, baseUs = single_image_us(weights, X);
+    std::cout << "hidden " << h1 << " x " << h2 << ", unit statistics over " << stats.count << " training images\n";
+    std::cout << "criterion   keep   h1   h2   params   test BCE    dBCE   1-image us  speedup  256-batch img/s\n";
+
+    std::vector<std::pair<std::string, PruneCriterion>> runs;
+    if (criteria != "activation") runs.push_back({"magnitude", PruneCriterion::Magnitude});
+    if (criteria != "magnitude") runs.push_back({"activation", PruneCriterion::Activation});
+    for (const auto &run : runs) {
+        for (double f : keep) {
+            const Weights pruned = prune_units(weights, stats, int(std::lround(f * h1)), int(std::lround(f * h2)), run.second);
+            const size_t params = size_t(pruned.W1.size() + pruned.b1.size() + pruned.W2.size() + pruned.b2.size() + pruned.W3.size() + pruned.b3.size());
+            const double bce = evaluate(pruned).bce, us = single_image_us(pruned, X);
+            std::cout << std::left << std::setw(10) << run.first << std::right << std::fixed << std::setprecision(3) << std::setw(6) << f
+                      << std::setw(5) << pruned.W1.cols() << std::setw(5) << pruned.W2.cols() << std::setw(9) << params << std::setprecision(5)
+                      << std::setw(11) << bce << std::showpos << std::setw(9) << bce - baseBce << std::noshowpos << std::setprecision(1)
+                      << std::setw(13) << us << std::setprecision(2) << std::setw(9) << baseUs / us << std::setprecision(0) << std::setw(17)
+                      << batch_images_per_s(pruned, X) << std::defaultfloat << "\n";
+            if (!prefix.empty()) {
+                const std::string path = prefix + run.first + "_" + std::to_string(int(std::lround(f * 100))) + ".bin";
+                if (!save_checkpoint(path, pruned, 0)) return 1;
+            }
+        }
+    }
+    return 0;
+}
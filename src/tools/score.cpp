@@ -0,0 +1,81 @@
+#include "../anomaly.h"
+#include "../image_stream.h"
+#include "../shape.h"
+#include "../weight_store.h"
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+// Usage: score [--checkpoint PATH] [--input FILE] [--raw-dim D] [--chunk N] [--top K] [--out FILE]
+// Streams FILE (IDX, or raw u8 rows of D pixels, default raw_shape) in chunks of N images, scores every image by
+// its reconstruction BCE, writes the scores to FILE (4 bytes per image, see anomaly.h) and prints
+// the K worst-reconstructed images. The next chunk is read while the current one is scored.
+// Exit status 1 if FILE could not be read to the end.
+int main(int argc, char **argv)
+{
+    std::string checkpoint, input = test_data, out = "scores.bin";
+    int rawDim = 0, top = 20;
+    size_t chunkRows = 16384;
+    for (int i = 1; i < argc; ++i) {
+        auto next = [&]() { return (i + 1 < argc) ? argv[++i] : (std::cerr << "missing value for " << argv[i] << "\n", std::exit(2), nullptr); };
+        if (!std::strcmp(argv[i], "--checkpoint")) checkpoint = next();
+        else if (!std::strcmp(argv[i], "--input")) input = next();
+        else if (!std::strcmp(argv[i], "--raw-dim")) rawDim = std::atoi(next());
+        else if (!std::strcmp(argv[i], "--chunk")) chunkRows = size_t(std::max(1, std::atoi(next())));
+        else if (!std::strcmp(argv[i], "--top")) top = std::max(1, std::atoi(next()));
+        else if (!std::strcmp(argv[i], "--out")) out = next();
+        else {
+            std::cerr << "usage: " << argv[0] << " [--checkpoint PATH] [--input FILE] [--raw-dim D] [--chunk N] [--top K] [--out FILE]\n";
+            return 2;
+        }
+    }
+
+    ImageStream stream;
+    if (!stream.open(input, rawDim > 0 ? ImageShape{rawDim, 1, 1} : raw_shape)) return 1;
+    Weights weights;
+    if (!checkpoint.empty()) {
+        if (!load_checkpoint(checkpoint, weights)) return 1;
+    } else {
+        std::cerr << "WARNING: no --checkpoint, scoring with untrained weights\n";
+    }
+    if (weights.W1.rows() != stream.dim()) {
+        std::cerr << "images have " << stream.dim() << " pixels, the weights expect " << weights.W1.rows() << "\n";
+        return 1;
+    }
+
+    ScoreWriter writer;
+    if (!writer.open(out, stream.dim())) return 1;
+    WorstK worst{size_t(top)};
+    ThreadPool &pool = global_pool();
+
+    const auto t0 = std::chrono::steady_clock::now();
+    MatrixXu8 chunks[2];
+    Eigen::VectorXf scores;
+    double sum = 0.0;
+    size_t first = 0;
+    size_t rows = stream.next(chunks[0], chunkRows);
+    for (int cur = 0; rows > 0; cur ^= 1) {
+        auto reading = pool.submit([&, nxt = cur ^ 1] { return stream.next(chunks[nxt], chunkRows); });
+        reconstruction_scores(weights, chunks[cur], scores, pool);
+        worst.add(scores, first);
+        sum += scores.cast<double>().sum();
+        const bool written = writer.append(scores);
+        rows = pool.wait(reading); // joined before any return: the task fills chunks[] from stream
+        if (!written) return 1;
+        first += size_t(scores.size());
+    }
+    if (!writer.close()) return 1;
+    if (stream.failed()) { // the scores cover only the images before the short read
+        std::cerr << "ERROR: " << input << " ended early: scored only " << first << " images, " << out << " is incomplete\n";
+        return 1;
+    }
+    const double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+    std::cout << "scored " << first << " images (" << stream.dim() << " pixels) in " << secs << " s: "
+              << double(first) / secs << " images/s\n"
+              << "mean BCE per image " << sum / double(std::max<size_t>(first, 1)) << " nats, scores in " << out << "\n"
+              << "worst " << top << ":\n";
+    for (const ScoredImage &s : worst.sorted()) std::cout << "  #" << s.index << "  " << s.score << "\n";
+    return 0;
+}
@@ -0,0 +1,99 @@
+#include "train.h"
+#include "profiler.h"
+#include "shape.h"
+#include <algorithm>
+#include <iostream>
+
+// ====== SETTINGS ======
+int accum_steps = 1;
+bool fused_update = true;
+size_t activation_budget = 0;
+
+Trainer::Trainer(ThreadPool &pool, int microBatches, uint32_t seed)
+    : pool(pool), losses(std::max(microBatches, 1)), updateInPlace(fused_update && microBatches <= 1),
+      keepOutput(activation_budget == 0 || activation_bytes(B, true) <= activation_budget)
+{
+    for (int k = 0; k < std::max(microBatches, 1); ++k) rngs.emplace_back(seed + uint32_t(k));
+    workers.resize(std::min<size_t>(rngs.size(), size_t(pool.size()) + 1));
+    for (Worker &w : workers) {
+        if (!keepOutput) w.forward = ForwardOutput(false);
+        if (updateInPlace) {
+            w.sum = Gradients(false);
+            w.scratch = Gradients(false);
+        }
+    }
+    if (!keepOutput) {
+        std::cout << "Activation budget " << activation_budget / 1e6 << " MB: recomputing the output layer in the backward ("
+                  << activation_bytes(B, false) / 1e6 << " MB per worker instead of " << activation_bytes(B, true) / 1e6 << ")\n";
+        if (activation_bytes(B, false) > activation_budget)
+            std::cerr << "WARNING: activation budget too small for B = " << B << " even with recomputation\n";
+    }
+}
+
+/**
+ * @brief Sample, forward and backward every micro-batch, reduce, and update the weights once.
+ * @param weights REFERENCE : read by every worker during the step, updated at the end.
+ * @return Mean of the micro-batch losses.
+ */
+double Trainer::step(Weights &weights)
+{
+    const int K = microBatches();
+    const int W = int(workers.size());
+
+    if (updateInPlace) {
+        Worker &worker = workers[0];
+        {
+            PROFILE_SCOPE("data");
+            worker.X = make_batch_u8(B, rngs[0], true, &worker.Xs);
+        }
+        const SparseBatch *sparse = useSparseInput(worker.Xs) ? &worker.Xs : nullptr;
+        forwardPass(worker.forward, weights, worker.X, sparse);
+        backPassUpdate(weights, worker.sum, worker.forward, worker.X, sparse);
+        losses[0] = worker.forward.loss;
+        return losses[0];
+    }
+
+    pool.parallelFor(W, [&](int w) {
+        Worker &worker = workers[w];
+        for (int k = w; k < K; k += W) {
+            {
+                PROFILE_SCOPE("data");
+                worker.X = make_batch_u8(B, rngs[k], true, &worker.Xs);
+            }
+            const SparseBatch *sparse = useSparseInput(worker.Xs) ? &worker.Xs : nullptr;
+            forwardPass(worker.forward, weights, worker.X, sparse);
+            losses[k] = worker.forward.loss;
+            if (k == w) {
+                backPass(worker.sum, worker.forward, weights, worker.X, sparse);
+            } else {
+                backPass(worker.scratch, worker.forward, weights, worker.X, sparse);
+                addGradients(worker.sum, worker.scratch);
+            }
+        }
+    });
+
+    {
+        PROFILE_SCOPE("reduce");
+        for (int w = 1; w < W; ++w) addGradients(workers[0].sum, workers[w].sum);
+        // backPass averages over its own B samples; average over the K micro-batches too.
+        if (K > 1) scaleGradients(workers[0].sum, 1.0f / float(K));
+    }
+    backProp(weights, workers[0].sum);
+
+    double loss = 0.0;
+    for (double l : losses) loss += l;
+    return loss / K;
+}
+
+size_t Trainer::workspaceBytes() const
+{
+    auto bytes = [](const auto &m) { return size_t(m.size()) * sizeof(typename std::decay_t<decltype(m)>::Scalar); };
+    size_t perWorker = bytes(workers[0].X) + size_t(B) * D * 2 * sizeof(float); // dense batch + worst-case CSR
+    const ForwardOutput &f = workers[0].forward;
+    perWorker += bytes(f.H) + bytes(f.A2) + bytes(f.sigmoid) + bytes(f.tile);
+    const Gradients &g = workers[0].sum;
+    const size_t grads = bytes(g.Gy) + bytes(g.Gw3) + bytes(g.Ga2) + bytes(g.Gz2) + bytes(g.Gw2) + bytes(g.Gh) +
+                         bytes(g.Gz) + bytes(g.Gw1) + bytes(g.Gb3) + bytes(g.Gb2) + bytes(g.Gb1) + bytes(g.tile);
+    perWorker += grads * (microBatches() > int(workers.size()) ? 2 : 1); // scratch only used past the first pass
+    return perWorker * workers.size();
+}
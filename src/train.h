@@ -0,0 +1,53 @@
+#ifndef TRAIN_H
+#define TRAIN_H
+
+#include "network.h"
+#include "thread_pool.h"
+#include <random>
+#include <vector>
+
+// ====== SETTINGS ======
+extern int accum_steps;   // micro-batches of B samples per weight update (effective batch = accum_steps * B)
+extern bool fused_update; // with one micro-batch, apply SGD inside the backward (backPassUpdate), no Gw buffers
+extern size_t activation_budget; // bytes of batch-sized buffers per worker (activation_bytes), 0 = no limit
+
+/**
+ * @brief One training step = accum_steps micro-batches of B samples, run in parallel on the pool,
+ * @brief gradients summed in place and averaged, then a single backProp().
+ * @brief Activation memory is one ForwardOutput per worker, not per micro-batch, so the effective
+ * @brief batch can grow without growing the activations.
+ * @brief Micro-batch k always draws from its own RNG stream and always runs on worker k % workers,
+ * @brief and the workers are reduced in a fixed order, so a run is reproducible for a given pool size.
+ * @brief With a single micro-batch and fused_update there is nothing to reduce: the backward
+ * @brief updates the weights itself and the workers hold no weight gradients at all.
+ * @brief When keeping every activation would exceed activation_budget, the workers drop the
+ * @brief (B, D) output and the backward recomputes it from A2: one more B x H x D GEMM per step.
+ */
+class Trainer
+{
+public:
+    Trainer(ThreadPool &pool, int microBatches, uint32_t seed);
+
+    double step(Weights &weights); // mean loss over the micro-batches
+    size_t workspaceBytes() const; // activations + gradients held by the workers
+    int microBatches() const { return int(rngs.size()); }
+
+private:
+    struct Worker
+    {
+        MatrixXu8 X;
+        SparseBatch Xs;
+        ForwardOutput forward;
+        Gradients scratch; // backPass target for every micro-batch after the first
+        Gradients sum;     // running sum for this worker
+    };
+
+    ThreadPool &pool;
+    std::vector<std::mt19937> rngs; // one per micro-batch index
+    std::vector<Worker> workers;
+    std::vector<double> losses;
+    bool updateInPlace; // fused_update with one micro-batch, fixed at construction
+    bool keepOutput;    // from the activation plan, fixed at construction
+};
+
+#endif // TRAIN_H
@@ -0,0 +1,171 @@
+#include "weight_store.h"
+#include "profiler.h"
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+// ====== SETTINGS ======
+int publish_every = 100;
+int checkpoint_every = 5000;
+
+WeightPublisher::WeightPublisher(int n)
+{
+    for (int i = 0; i < std::max(n, 2); ++i) slots.push_back(std::make_unique<Slot>());
+}
+
+/**
+ * @brief Copy the weights into a slot no reader holds, then swap it in.
+ * @return false (and nothing published) if readers pin every slot but the current one.
+ */
+bool WeightPublisher::publish(const Weights &weights, size_t iteration)
+{
+    PROFILE_SCOPE("publish");
+    const int cur = current.load();
+    for (int s = 0; s < int(slots.size()); ++s) {
+        if (s == cur || slots[s]->readers.load() != 0) continue;
+        // A reader may still bump this count from a stale index, but it re-checks current
+        // before touching the slot and backs off, so the copy below is never observed.
+        Slot &slot = *slots[s];
+        slot.weights = weights;
+        slot.iteration = iteration;
+        slot.version = published.load() + 1;
+        current.store(s);
+        published.store(slot.version);
+        return true;
+    }
+    ++skippedCount;
+    return false;
+}
+
+/**
+ * @brief Pin the current version: two atomic increments/loads, no lock, no copy.
+ */
+WeightPublisher::Reader WeightPublisher::acquire() const
+{
+    for (;;) {
+        const int s = current.load();
+        if (s < 0) return Reader();
+        slots[s]->readers.fetch_add(1);
+        if (current.load() == s) return Reader(slots[s].get());
+        slots[s]->readers.fetch_sub(1); // republished meanwhile: the slot may be rewritten, retry
+    }
+}
+
+WeightPublisher::Reader &WeightPublisher::Reader::operator=(Reader &&other) noexcept
+{
+    if (this != &other) {
+        release();
+        slot = other.slot;
+        other.slot = nullptr;
+    }
+    return *this;
+}
+
+void WeightPublisher::Reader::release()
+{
+    if (slot) slot->readers.fetch_sub(1);
+    slot = nullptr;
+}
+
+
+// ------------------------------------------------------------
+// Checkpoints: "VAEW", format version, iteration, then W1 b1 W2 b2 W3 b3,
+// each as rows, cols (u32) and row-major float32 values (native endianness)
+// ------------------------------------------------------------
+static const char kMagic[4] = {'V', 'A', 'E', 'W'};
+static const uint32_t kFormat = 1;
+
+template <typename M>
+static void write_tensor(std::ofstream &f, const M &m)
+{
+    const uint32_t dims[2] = {uint32_t(m.rows()), uint32_t(m.cols())};
+    f.write((const char *)dims, sizeof(dims));
+    const MatrixXfRow rowMajor = m; // one layout on disk whatever the in-memory one
+    f.write((const char *)rowMajor.data(), std::streamsize(rowMajor.size() * sizeof(float)));
+}
+
+template <typename M>
+static bool read_tensor(std::ifstream &f, M &m)
+{
+    uint32_t dims[2];
+    if (!f.read((char *)dims, sizeof(dims))) return false;
+    if (M::RowsAtCompileTime == 1 && dims[0] != 1) return false;
+    MatrixXfRow rowMajor(dims[0], dims[1]);
+    if (!f.read((char *)rowMajor.data(), std::streamsize(rowMajor.size() * sizeof(float)))) return false;
+    m = rowMajor;
+    return true;
+}
+
+/**
+ * @brief Write the weights to path (via a temporary file, so a crash never leaves a torn checkpoint).
+ */
+bool save_checkpoint(const std::string &path, const Weights &weights, size_t iteration)
+{
+    PROFILE_SCOPE("checkpoint.save");
+    const std::string tmp = path + ".tmp";
+    {
+        std::ofstream f(tmp, std::ios::binary);
+        if (!f) {
+            std::cerr << "ERROR: cannot write checkpoint: " << tmp << "\n";
+            return false;
+        }
+        const uint64_t it = iteration;
+        f.write(kMagic, sizeof(kMagic));
+        f.write((const char *)&kFormat, sizeof(kFormat));
+        f.write((const char *)&it, sizeof(it));
+        write_tensor(f, weights.W1);
+        write_tensor(f, weights.b1);
+        write_tensor(f, weights.W2);
+        write_tensor(f, weights.b2);
+        write_tensor(f, weights.W3);
+        write_tensor(f, weights.b3);
+        if (!f) {
+            std::cerr << "ERROR: short write on checkpoint: " << tmp << "\n";
+            return false;
+        }
+    }
+    if (std::rename(tmp.c_str(), path.c_str()) != 0) {
+        std::cerr << "ERROR: cannot move checkpoint into place: " << path << "\n";
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Read a checkpoint written by save_checkpoint().
+ * @brief The tensors take the shapes stored in the file; callers that size buffers from
+ * @brief D / H_size check weights.W1 against them.
+ */
+bool load_checkpoint(const std::string &path, Weights &weights, size_t *iteration)
+{
+    std::ifstream f(path, std::ios::binary);
+    if (!f) {
+        std::cerr << "ERROR: cannot open checkpoint: " << path << "\n";
+        return false;
+    }
+    char magic[4];
+    uint32_t format = 0;
+    uint64_t it = 0;
+    f.read(magic, sizeof(magic));
+    f.read((char *)&format, sizeof(format));
+    f.read((char *)&it, sizeof(it));
+    if (!f || std::memcmp(magic, kMagic, sizeof(kMagic)) != 0 || format != kFormat) {
+        std::cerr << "ERROR: not a checkpoint (or unknown format): " << path << "\n";
+        return false;
+    }
+
+    Weights loaded;
+    const bool ok = read_tensor(f, loaded.W1) && read_tensor(f, loaded.b1) && read_tensor(f, loaded.W2) &&
+                    read_tensor(f, loaded.b2) && read_tensor(f, loaded.W3) && read_tensor(f, loaded.b3);
+    const bool consistent = ok && loaded.b1.cols() == loaded.W1.cols() && loaded.W2.rows() == loaded.W1.cols() &&
+                            loaded.b2.cols() == loaded.W2.cols() && loaded.W3.rows() == loaded.W2.cols() &&
+                            loaded.b3.cols() == loaded.W3.cols() && loaded.W3.cols() == loaded.W1.rows();
+    if (!consistent) {
+        std::cerr << "ERROR: truncated or inconsistent checkpoint: " << path << "\n";
+        return false;
+    }
+    weights = std::move(loaded);
+    if (iteration) *iteration = size_t(it);
+    return true;
+}
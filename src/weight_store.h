@@ -0,0 +1,72 @@
+#ifndef WEIGHT_STORE_H
+#define WEIGHT_STORE_H
+
+#include "network.h"
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+// ====== SETTINGS ======
+extern int publish_every;    // training steps between published weight versions
+extern int checkpoint_every; // iterations between background checkpoints, 0 = only at the end
+
+/**
+ * @brief Read-copy-update publication of the training weights.
+ * @brief publish() copies the weights into a spare slot and then makes it current with one
+ * @brief atomic store. acquire() pins the current slot with an atomic reader count and never
+ * @brief takes a lock; while pinned, a slot is never overwritten, so a reader sees one
+ * @brief consistent version for as long as it holds it, however far training moves on.
+ * @brief Single publisher (the training thread), any number of readers.
+ */
+class WeightPublisher
+{
+    struct Slot
+    {
+        Weights weights;
+        size_t iteration = 0;
+        size_t version = 0;
+        std::atomic<int> readers{0};
+    };
+
+public:
+    class Reader
+    {
+    public:
+        Reader() = default;
+        Reader(Reader &&other) noexcept : slot(other.slot) { other.slot = nullptr; }
+        Reader &operator=(Reader &&other) noexcept;
+        Reader(const Reader &) = delete;
+        Reader &operator=(const Reader &) = delete;
+        ~Reader() { release(); }
+
+        explicit operator bool() const { return slot != nullptr; }
+        const Weights &weights() const { return slot->weights; }
+        size_t iteration() const { return slot->iteration; }
+        size_t version() const { return slot->version; }
+        void release();
+
+    private:
+        friend class WeightPublisher;
+        explicit Reader(Slot *slot) : slot(slot) {}
+        Slot *slot = nullptr;
+    };
+
+    explicit WeightPublisher(int slots = 4); // current + up to slots-2 pinned old versions + one being written
+
+    bool publish(const Weights &weights, size_t iteration); // false if every spare slot is pinned
+    Reader acquire() const;                                  // empty until the first publish()
+    size_t version() const { return published.load(); }
+    size_t skipped() const { return skippedCount; }
+
+private:
+    std::vector<std::unique_ptr<Slot>> slots;
+    std::atomic<int> current{-1};
+    std::atomic<size_t> published{0};
+    size_t skippedCount = 0;
+};
+
+bool save_checkpoint(const std::string &path, const Weights &weights, size_t iteration);
+bool load_checkpoint(const std::string &path, Weights &weights, size_t *iteration = nullptr); // tensors take the file's shapes
+
+#endif // WEIGHT_STORE_H